@@ -0,0 +1,101 @@
+// Checks that the message path makes no heap allocations once warmed up:
+// push into a channel queue, pop and encode on the session thread, write,
+// read into the client's arena, and decode in receive().
+// Run through ctest, or directly: ./bin/AllocTest [port]
+//
+// Every operator new in the process is counted, not just the BufferPool
+// counters, so allocations the pools cannot see (control blocks, container
+// growth, Asio handlers) are caught too. Heartbeats are pushed out of the
+// measured window: pings allocate per ping, independent of message traffic.
+
+#include "WebsocketClient.h"
+#include "WebsocketServer.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+
+static std::atomic<uint64_t> allocations { 0 };
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* data = std::malloc(size != 0 ? size : 1);
+    if (data == nullptr)
+        throw std::bad_alloc();
+    return data;
+}
+
+void operator delete(void* data) noexcept { std::free(data); }
+void operator delete(void* data, size_t) noexcept { std::free(data); }
+
+static int failures = 0;
+
+// Report a failed check
+static void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAIL: " << what << "\n";
+        ++failures;
+    }
+}
+
+// Push one message of each format in turn and wait for each to arrive
+static bool roundTrip(IMessageQueue& queue, WebSocketClient& client, int count) {
+    const MessageFormat formats[4] = { MESSAGE_FORMAT_WHEEL, MESSAGE_FORMAT_ARM,
+                                       MESSAGE_FORMAT_SCIENCE_TOOL, MESSAGE_FORMAT_GENERIC };
+    for (int i = 0; i < count; ++i) {
+        int priority = (i % 10 == 0) ? MESSAGE_PRIORITY_HIGH : MESSAGE_PRIORITY_LOW;
+        switch (i % 4) {
+            case 0: queue.push(Message(priority, WheelMessage{ i, -i, 7 })); break;
+            case 1: queue.push(Message(priority, ArmMessage{ i, 1, 2, 3, 4, 5, 6, -i })); break;
+            case 2: queue.push(Message(priority, ScienceToolMessage{ i, -1, 0, i })); break;
+            default: queue.push(Message(priority, Generic{ i })); break;
+        }
+        Message received = client.receive();
+        if (received.getFormat() != formats[i % 4])
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    unsigned short port = static_cast<unsigned short>(argc > 1 ? std::stoi(argv[1]) : 9192);
+    const int WARM_UP = 2000;
+    const int MEASURED = 10000;
+
+    HeartbeatConfig heartbeat;
+    heartbeat.idle = std::chrono::hours(1);
+    heartbeat.timeout = std::chrono::hours(2);
+
+    WebSocketServer server(port, false, heartbeat);
+    IMessageQueue& queue = server.addChannel("/");
+    std::thread([&server]() { server.run(); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    WebSocketClient client("127.0.0.1", std::to_string(port), "/", heartbeat);
+    client.connect();
+
+    // Let every pool, buffer and handler cache reach its working size
+    expect(roundTrip(queue, client, WARM_UP), "warm-up messages arrive in order");
+
+    // Nothing but the round trips may run in this window
+    uint64_t before = allocations.load();
+    bool inOrder = roundTrip(queue, client, MEASURED);
+    uint64_t allocated = allocations.load() - before;
+
+    expect(inOrder, "measured messages arrive in order");
+    expect(allocated == 0, "no heap allocations in steady state (saw "
+                           + std::to_string(allocated) + " for " + std::to_string(MEASURED) + " messages)");
+
+    expect(client.bufferStats().poolMisses == 0, "client arena served every frame");
+    for (const auto& session : server.sessions())
+        expect(session.buffers.poolMisses == 0, "session encoding pool served every message");
+
+    if (failures == 0)
+        std::cout << "Allocation tests passed\n";
+    std::cout.flush();
+
+    // The server has no shutdown; leave without unwinding its threads
+    std::_Exit(failures == 0 ? 0 : 1);
+}
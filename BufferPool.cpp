@@ -0,0 +1,107 @@
+#include "BufferPool.h"
+
+//--------------//
+/* PooledBuffer */
+//--------------//
+
+// Default Constructor (no storage)
+PooledBuffer::PooledBuffer() :
+    m_pool(nullptr), m_data(nullptr), m_capacity(0), m_size(0) { }
+
+PooledBuffer::PooledBuffer(BufferPool* pool, char* data, size_t capacity) :
+    m_pool(pool), m_data(data), m_capacity(capacity), m_size(0) { }
+
+// Move Constructor
+PooledBuffer::PooledBuffer(PooledBuffer&& src) noexcept :
+    m_pool(src.m_pool), m_data(src.m_data), m_capacity(src.m_capacity), m_size(src.m_size) {
+    src.m_pool = nullptr;
+    src.m_data = nullptr;
+    src.m_capacity = 0;
+    src.m_size = 0;
+}
+
+// Move Assignment Operator
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& src) noexcept {
+    if (this != &src) {
+        release();
+        m_pool = src.m_pool;
+        m_data = src.m_data;
+        m_capacity = src.m_capacity;
+        m_size = src.m_size;
+        src.m_pool = nullptr;
+        src.m_data = nullptr;
+        src.m_capacity = 0;
+        src.m_size = 0;
+    }
+    return *this;
+}
+
+// Destructor
+PooledBuffer::~PooledBuffer() { release(); }
+
+// Give the storage back to its pool
+void PooledBuffer::release() {
+    if (m_pool != nullptr)
+        m_pool->deallocate(m_data);
+    m_pool = nullptr;
+    m_data = nullptr;
+    m_capacity = 0;
+    m_size = 0;
+}
+
+//------------//
+/* BufferPool */
+//------------//
+
+// Constructor
+BufferPool::BufferPool(size_t blocks, size_t blockSize) :
+    m_blocks(blocks), m_blockSize(blockSize), m_slab(new char[blocks * blockSize]),
+    m_acquires(0), m_poolMisses(0) {
+    m_free.reserve(blocks);
+    for (size_t i = 0; i < blocks; ++i)
+        m_free.push_back(m_slab.get() + i * blockSize);
+}
+
+// Borrow a block as a PooledBuffer
+PooledBuffer BufferPool::acquire(size_t size) {
+    size_t capacity = size > m_blockSize ? size : m_blockSize;
+    return PooledBuffer(this, static_cast<char*>(allocate(capacity)), capacity);
+}
+
+// Take a block, falling back to the heap when exhausted or oversized
+void* BufferPool::allocate(size_t size) {
+    m_acquires.fetch_add(1, std::memory_order_relaxed);
+
+    if (size <= m_blockSize) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free.empty()) {
+            char* block = m_free.back();
+            m_free.pop_back();
+            return block;
+        }
+    }
+
+    m_poolMisses.fetch_add(1, std::memory_order_relaxed);
+    return new char[size > m_blockSize ? size : m_blockSize];
+}
+
+// Return a block to the free list, or free it if it came from the heap
+void BufferPool::deallocate(void* storage) {
+    char* data = static_cast<char*>(storage);
+    char* slabBegin = m_slab.get();
+    char* slabEnd = slabBegin + m_blocks * m_blockSize;
+
+    if (data >= slabBegin && data < slabEnd) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(data);
+    } else {
+        delete[] data;
+    }
+}
+
+// Snapshot the allocation counters
+BufferPool::Stats BufferPool::stats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return { m_acquires.load(), m_poolMisses.load(),
+             m_blocks - m_free.size(), m_blocks };
+}
@@ -0,0 +1,167 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#pragma once
+
+#define BUFFER_POOL_BLOCK_SIZE 256 // Bytes per block; fits any serialized Message
+
+class BufferPool;
+
+// A byte buffer borrowed from a BufferPool. Returned to the pool when destroyed.
+// Move-only.
+class PooledBuffer {
+public:
+    PooledBuffer();
+    PooledBuffer(PooledBuffer&& src) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& src) noexcept;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+    ~PooledBuffer();
+
+    char* data() { return m_data; }
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    bool empty() const { return m_size == 0; }
+
+    /** Sets the number of bytes in use
+     *
+     * @param
+     * size (size_t): the new size, at most capacity()
+     *
+     * @return
+     * none
+     */
+    void resize(size_t size) { m_size = size; }
+
+private:
+    friend class BufferPool;
+    PooledBuffer(BufferPool* pool, char* data, size_t capacity);
+    void release();
+
+    BufferPool* m_pool;  // Owning pool (nullptr when empty)
+    char* m_data;        // Block storage
+    size_t m_capacity;   // Usable bytes in the block
+    size_t m_size;       // Bytes in use
+};
+
+// Fixed-size blocks carved from one preallocated slab. Acquiring and releasing
+// a block takes a short lock and never touches the heap unless the pool is
+// exhausted or an oversized buffer is requested, which is counted in
+// Stats::poolMisses. Blocks may be released from any thread.
+//
+// The counters only see this pool, so a zero poolMisses does not by itself
+// mean the path is allocation-free. AllocTest (run by ctest) counts every heap
+// allocation while messages go from push to receive() and requires none once
+// warmed up. Heartbeat pings are outside that check; they allocate per ping.
+//
+// Example Usage:
+//   BufferPool arena(64);
+//   PooledBuffer buf = arena.acquire();
+//   buf.resize(msg.serializeTo(buf.data(), buf.capacity()));
+class BufferPool {
+public:
+    // Counters for checking that the pool is sized for the steady state
+    struct Stats {
+        uint64_t acquires;         // Total buffers handed out
+        uint64_t poolMisses;       // Buffers the pool could not serve (taken from the heap instead)
+        size_t inUse;              // Pool blocks currently handed out
+        size_t blocks;             // Pool blocks in the slab
+    };
+
+    /** Constructor for BufferPool
+     *
+     * @param
+     * blocks (size_t): number of blocks to preallocate
+     * blockSize (size_t): bytes per block
+     */
+    BufferPool(size_t blocks, size_t blockSize = BUFFER_POOL_BLOCK_SIZE);
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /** Borrows a buffer with at least `size` bytes of capacity
+     *
+     * @param
+     * size (size_t): minimum capacity needed (defaults to one block)
+     *
+     * @return
+     * (PooledBuffer) the borrowed buffer
+     */
+    PooledBuffer acquire(size_t size = 0);
+
+    /** Allocates raw storage of at least `size` bytes (see PoolAllocator)
+     *
+     * @param
+     * size (size_t): bytes needed
+     *
+     * @return
+     * (void*) the storage, aligned for any fundamental type
+     */
+    void* allocate(size_t size);
+
+    /** Returns storage obtained from allocate()
+     *
+     * @param
+     * data (void*): the storage
+     *
+     * @return
+     * none
+     */
+    void deallocate(void* data);
+
+    /** Returns the allocation counters
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (Stats) the current counters
+     */
+    Stats stats();
+
+    size_t blockSize() const { return m_blockSize; }
+
+private:
+    size_t m_blocks;
+    size_t m_blockSize;
+    std::unique_ptr<char[]> m_slab;   // Storage for all blocks
+    std::vector<char*> m_free;        // Free blocks (reserved up front)
+    std::mutex m_mutex;               // Guards m_free
+    std::atomic<uint64_t> m_acquires;
+    std::atomic<uint64_t> m_poolMisses;
+};
+
+// Standard allocator drawing from a BufferPool, e.g. for std::allocate_shared.
+// Shares ownership of the pool, so a pool stays alive while anything
+// allocated from it (through a copy of the allocator) is still around.
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(std::shared_ptr<BufferPool> pool) : m_pool(std::move(pool)) { }
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& src) : m_pool(src.pool()) { }
+
+    T* allocate(size_t n) { return static_cast<T*>(m_pool->allocate(n * sizeof(T))); }
+    void deallocate(T* data, size_t) { m_pool->deallocate(data); }
+
+    const std::shared_ptr<BufferPool>& pool() const { return m_pool; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& rhs) const { return m_pool == rhs.pool(); }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& rhs) const { return m_pool != rhs.pool(); }
+
+private:
+    std::shared_ptr<BufferPool> m_pool;
+};
+
+#endif
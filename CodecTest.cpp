@@ -0,0 +1,192 @@
+// Checks that TextCodec writes exactly what the old iostream serialize() did,
+// for every format and at the edges of the int range, and that malformed
+// input is rejected with the right error.
+// Run through ctest, or directly: ./bin/CodecTest
+
+#include "TextCodec.h"
+#include <climits>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+static int failures = 0;
+
+// Report a failed check
+static void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAIL: " << what << "\n";
+        ++failures;
+    }
+}
+
+// The encoder TextCodec replaced, kept here as the reference for legacy tooling
+static std::string legacySerialize(const Message& message) {
+    std::ostringstream oss;
+    oss << message.isHighPriority() << " " << static_cast<int>(message.getFormat()) << " ";
+
+    std::visit([&oss](auto&& payload) {
+        using T = std::decay_t<decltype(payload)>;
+
+        if constexpr (std::is_same_v<T, Generic>) {
+            oss << payload.value;
+        } else if constexpr (std::is_same_v<T, WheelMessage>) {
+            oss << payload.velocity << " " << payload.theta << " " << payload.angle_velocity;
+        } else if constexpr (std::is_same_v<T, ArmMessage>) {
+            oss << payload.armXPos << " " << payload.armYPos << " " << payload.armZPos << " "
+                << payload.clawXPos << " " << payload.clawYPos << " " << payload.clawOpen << " "
+                << payload.clawRotation << " " << payload.wristRotation;
+        } else if constexpr (std::is_same_v<T, ScienceToolMessage>) {
+            oss << payload.moveUpDown << " " << payload.moveLeftRight << " "
+                << payload.xPos << " " << payload.yPos;
+        }
+    }, message.getPayload());
+
+    return oss.str();
+}
+
+// Encode with TextCodec into a buffer of exactly the maximum size
+static std::string encode(const Message& message) {
+    char out[TEXT_CODEC_MAX_SIZE];
+    size_t size = TextCodec::encode(message, out, sizeof out);
+    return std::string(out, size);
+}
+
+// Both encoders must produce the golden string, and it must decode back to the same bytes
+static void golden(const Message& message, const std::string& expected) {
+    expect(legacySerialize(message) == expected, "legacy reference gives \"" + expected + "\"");
+    expect(encode(message) == expected, "encode gives \"" + expected + "\", got \"" + encode(message) + "\"");
+    expect(message.serialize() == expected, "serialize gives \"" + expected + "\"");
+
+    Message decoded;
+    DecodeResult result = TextCodec::decode(expected, decoded);
+    expect(result && encode(decoded) == expected, "\"" + expected + "\" decodes and re-encodes unchanged");
+}
+
+// Decoding must fail with this error at this byte offset
+static void rejects(const std::string& text, CodecError error, size_t position) {
+    Message decoded(1, WheelMessage{ 7, 7, 7 });
+    DecodeResult result = TextCodec::decode(text, decoded);
+    expect(result.error == error, "\"" + text + "\" is rejected as " + TextCodec::errorString(error)
+                                  + ", got " + TextCodec::errorString(result.error));
+    expect(result.position == position, "\"" + text + "\" is rejected at byte " + std::to_string(position)
+                                        + ", got " + std::to_string(result.position));
+    expect(encode(decoded) == "1 0 7 7 7", "\"" + text + "\" leaves the message unchanged");
+}
+
+// Decoding must succeed and re-encode to the canonical form
+static void accepts(const std::string& text, const std::string& canonical) {
+    Message decoded;
+    DecodeResult result = TextCodec::decode(text, decoded);
+    expect(result && encode(decoded) == canonical, "\"" + text + "\" decodes as \"" + canonical + "\"");
+}
+
+// Every format, with edge values
+static void goldenStrings() {
+    golden(Message(0, Generic{ 0 }), "0 -1 0");
+    golden(Message(1, Generic{ -42 }), "1 -1 -42");
+    golden(Message(0, Generic{ INT_MIN }), "0 -1 -2147483648");
+    golden(Message(1, Generic{ INT_MAX }), "1 -1 2147483647");
+
+    golden(Message(1, WheelMessage{ 120, 45, 10 }), "1 0 120 45 10");
+    golden(Message(0, WheelMessage{ -100, 0, -1 }), "0 0 -100 0 -1");
+    golden(Message(0, WheelMessage{ INT_MIN, INT_MAX, INT_MIN }), "0 0 -2147483648 2147483647 -2147483648");
+
+    golden(Message(0, ArmMessage{ 1, 2, 3, 4, 5, 6, 7, 8 }), "0 1 1 2 3 4 5 6 7 8");
+    golden(Message(1, ArmMessage{ -1, -20, -300, 0, 99999, -100000, 1, -8 }),
+           "1 1 -1 -20 -300 0 99999 -100000 1 -8");
+    golden(Message(1, ArmMessage{ INT_MIN, INT_MAX, INT_MIN, INT_MAX, INT_MIN, INT_MAX, INT_MIN, INT_MAX }),
+           "1 1 -2147483648 2147483647 -2147483648 2147483647 -2147483648 2147483647 -2147483648 2147483647");
+
+    golden(Message(0, ScienceToolMessage{ 0, 0, 0, 0 }), "0 2 0 0 0 0");
+    golden(Message(1, ScienceToolMessage{ -5, 5, INT_MAX, INT_MIN }), "1 2 -5 5 2147483647 -2147483648");
+}
+
+// Random messages, mostly near the edges of the int range, against the reference
+static void randomMessages() {
+    std::mt19937 random(33);
+    std::uniform_int_distribution<int> any(INT_MIN, INT_MAX);
+    std::uniform_int_distribution<int> pick(0, 9);
+    auto value = [&]() {
+        switch (pick(random)) {
+            case 0: return INT_MIN;
+            case 1: return INT_MAX;
+            case 2: return INT_MIN + 1;
+            case 3: return 0;
+            case 4: return -1;
+            case 5: return pick(random) - 5;
+            default: return any(random);
+        }
+    };
+
+    for (int i = 0; i < 20000; ++i) {
+        int priority = i % 2;
+        Message message;
+        switch (i % 4) {
+            case 0: message = Message(priority, Generic{ value() }); break;
+            case 1: message = Message(priority, WheelMessage{ value(), value(), value() }); break;
+            case 2: message = Message(priority, ArmMessage{ value(), value(), value(), value(),
+                                                            value(), value(), value(), value() }); break;
+            default: message = Message(priority, ScienceToolMessage{ value(), value(), value(), value() }); break;
+        }
+
+        std::string expected = legacySerialize(message);
+        if (encode(message) != expected) {
+            expect(false, "random message encodes as \"" + expected + "\", got \"" + encode(message) + "\"");
+            return;
+        }
+    }
+}
+
+// Output that does not fit is truncated, but the full length is reported
+static void truncation() {
+    Message message(1, ArmMessage{ INT_MIN, INT_MAX, INT_MIN, INT_MAX, INT_MIN, INT_MAX, INT_MIN, INT_MAX });
+    std::string full = encode(message);
+    char small[16];
+    size_t size = TextCodec::encode(message, small, sizeof small);
+    expect(size == full.size(), "truncated encode reports the full length");
+    expect(std::string(small, sizeof small) == full.substr(0, sizeof small), "truncated encode keeps the prefix");
+}
+
+// What istream used to accept is still accepted
+static void lenientInput() {
+    accepts("1\t0  120\n45 10", "1 0 120 45 10");
+    accepts("  0 0 1 2 3  ", "0 0 1 2 3");
+    accepts("0 0 +1 2 3", "0 0 1 2 3");
+    accepts("0 -1 -2147483648", "0 -1 -2147483648");
+}
+
+// Malformed input, with the error and the byte it is reported at
+static void malformedInput() {
+    rejects("", CodecError::Empty, 0);
+    rejects("   ", CodecError::Empty, 3);
+    rejects("2 0 1 2 3", CodecError::BadPriority, 0);
+    rejects("-1 0 1 2 3", CodecError::BadPriority, 0);
+    rejects("x 0 1 2 3", CodecError::BadPriority, 0);
+    rejects("0", CodecError::MissingField, 1);
+    rejects("0 x 1", CodecError::BadFormat, 2);
+    rejects("0 7 1", CodecError::BadFormat, 2);
+    rejects("0 -2 1", CodecError::BadFormat, 2);
+    rejects("0 0 1 2", CodecError::MissingField, 7);
+    rejects("0 1 1 2 3 4 5 6 7", CodecError::MissingField, 17);
+    rejects("0 0 1 x 3", CodecError::BadField, 6);
+    rejects("0 0 1 2 3x", CodecError::BadField, 8);
+    rejects("0 0 1 2 2147483648", CodecError::BadField, 8);
+    rejects("0 0 1 2 -2147483649", CodecError::BadField, 8);
+    rejects("0 0 1.5 2 3", CodecError::BadField, 4);
+    rejects("0 0 1 2 3 4", CodecError::TrailingData, 10);
+    rejects("0 -1 5 q=1", CodecError::TrailingData, 7);
+    rejects("0 -1 5 t=x", CodecError::BadField, 7);
+}
+
+int main() {
+    goldenStrings();
+    randomMessages();
+    truncation();
+    lenientInput();
+    malformedInput();
+
+    if (failures == 0)
+        std::cout << "Codec tests passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+#include "DualStreamClient.h"
+#include <stdexcept>
+
+// Constructor
+DualStreamClient::DualStreamClient(const std::string& host, const std::string& port,
+                                   const std::string& target, HeartbeatConfig heartbeat)
+    : m_priority(host, port, target + "?stream=priority", heartbeat),
+      m_regular(host, port, target + "?stream=regular", heartbeat)
+{
+    // Both IO threads wake the receiving thread
+    auto wake = [this]() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_ready = true;
+        m_cond.notify_all();
+    };
+    m_priority.onReady(wake);
+    m_regular.onReady(wake);
+}
+
+// Connect the priority stream first so the server never routes high priority
+// messages to the regular stream once both are up
+void DualStreamClient::connect() {
+    m_priority.connect();
+    m_regular.connect();
+}
+
+// Return the lower-numbered head, waiting until one stream has something
+Message DualStreamClient::receive() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_ready = false;
+        if (fill())
+            break;
+        m_cond.wait(lock, [this]() { return m_ready; });
+    }
+
+    int next = !m_hasHead[1] ? 0
+             : !m_hasHead[0] ? 1
+             : m_heads[0].sequence() <= m_heads[1].sequence() ? 0 : 1;
+
+    m_hasHead[next] = false;
+    return m_heads[next];
+}
+
+// Close both connections
+void DualStreamClient::close() {
+    m_priority.close();
+    m_regular.close();
+}
+
+/*
+ * Take the next message of each live stream that has none waiting. A lost
+ * stream is left alone; the other one still carries its traffic, so the
+ * loss is only reported once both are gone and nothing is left to return
+ */
+bool DualStreamClient::fill() {
+    WebSocketClient* streams[2] = { &m_priority, &m_regular };
+
+    for (int i = 0; i < 2; ++i) {
+        if (m_hasHead[i] || !m_lost[i].empty())
+            continue;
+        try {
+            m_hasHead[i] = streams[i]->tryReceive(m_heads[i]);
+        } catch (const std::runtime_error& e) {
+            m_lost[i] = e.what();
+        }
+    }
+
+    if (m_hasHead[0] || m_hasHead[1])
+        return true;
+    if (!m_lost[0].empty() && !m_lost[1].empty())
+        throw std::runtime_error("priority stream: " + m_lost[0] + "; regular stream: " + m_lost[1]);
+    return false;
+}
@@ -0,0 +1,101 @@
+#ifndef DUAL_STREAM_CLIENT_H
+#define DUAL_STREAM_CLIENT_H
+
+#include "WebsocketClient.h"
+#include "Heartbeat.h"
+#include "Message.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#pragma once
+
+// Client for a channel in dual-stream mode.
+//
+// Opens two connections to the same channel: "?stream=priority" carries only
+// high priority messages and "?stream=regular" everything else. An e-stop
+// therefore never waits behind a large or slow regular write; its worst-case
+// delay is one small frame on its own connection. The server numbers messages
+// across both streams, and receive() merges them back in that order.
+//
+// A message is returned as soon as it arrives: if the priority stream has
+// message 12 while 11 is still in flight on the regular stream, 12 is
+// returned first rather than held back. Within each stream order is kept.
+//
+// Example Usage:
+//   DualStreamClient client("127.0.0.1", "8080", "/wheel");
+//   client.connect();
+//   Message msg = client.receive();
+class DualStreamClient {
+public:
+    /** Constructor for DualStreamClient
+     *
+     * @param
+     *  host: const std::string& - The server host address (e.g., "127.0.0.1")
+     *  port: const std::string& - The server port (e.g., "8080")
+     *  target: const std::string& - The channel to join (e.g., "/wheel", default "/")
+     *  heartbeat: HeartbeatConfig - Ping interval and dead-link timeout for both connections
+     */
+    DualStreamClient(const std::string& host, const std::string& port,
+                     const std::string& target = "/",
+                     HeartbeatConfig heartbeat = HeartbeatConfig());
+
+    /** Connects both streams, the priority stream first
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  none
+     */
+    void connect();
+
+    /** Receives the next message from either stream, lowest sequence number
+     * first among those that have arrived
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  Message - The received message
+     *
+     * Throws std::runtime_error once both connections are lost and no
+     * received messages remain. While only one is lost, the other keeps
+     * being read (the server sends all traffic to the regular stream once
+     * the priority stream is gone).
+     */
+    Message receive();
+
+    /** Closes both connections
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  none
+     */
+    void close();
+
+    // Smoothed RTT of each connection (-1 before the first pong)
+    std::chrono::microseconds priorityRtt() const { return m_priority.rtt(); }
+    std::chrono::microseconds regularRtt() const { return m_regular.rtt(); }
+
+private:
+    // Pull the next message of each live stream that has none waiting. Throws
+    // if both streams are lost and neither has a message
+    bool fill();
+
+    // Declared before the clients so they outlive the clients' IO threads,
+    // which call the ready callback until they are joined
+    std::mutex m_mutex;               // Guards the fields below
+    std::condition_variable m_cond;
+    bool m_ready = false;             // A stream reported activity since the last fill()
+    Message m_heads[2];               // Next message of the priority and regular streams
+    bool m_hasHead[2] = { false, false };
+    std::string m_lost[2];            // Why each stream was lost (empty while it is up)
+
+    WebSocketClient m_priority;
+    WebSocketClient m_regular;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "FlowControl.h"
+#include <vector>
+
+// Constructor
+FlowControl::FlowControl(FlowControlConfig config) : m_config(config) { }
+
+// Fold a write completion time into the average and re-evaluate
+void FlowControl::onWriteComplete(Clock::duration elapsed, size_t pendingBytes) {
+    int64_t sample = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    m_writeEwmaUs += (sample - m_writeEwmaUs) / 4;
+    m_pending.store(pendingBytes, std::memory_order_relaxed);
+    update();
+}
+
+// Track the socket draining while no write is in flight
+void FlowControl::onPendingBytes(size_t pendingBytes) {
+    m_pending.store(pendingBytes, std::memory_order_relaxed);
+    update();
+}
+
+// Enter congestion above the high thresholds, leave it below both low ones
+void FlowControl::update() {
+    size_t pending = m_pending.load(std::memory_order_relaxed);
+    auto writeTime = std::chrono::microseconds(m_writeEwmaUs);
+
+    if (!congested()) {
+        if (pending > m_config.pendingHigh || writeTime > m_config.writeHigh)
+            m_congested.store(true, std::memory_order_relaxed);
+    } else {
+        if (pending < m_config.pendingLow && writeTime < m_config.writeLow)
+            m_congested.store(false, std::memory_order_relaxed);
+    }
+}
+
+// A write still outstanding past the high threshold is already too slow
+void FlowControl::onWriteStalled(Clock::duration inFlight) {
+    if (inFlight > m_config.writeHigh)
+        m_congested.store(true, std::memory_order_relaxed);
+}
+
+// Keep conflating the queue's regular traffic while behind
+void FlowControl::hold(IMessageQueue& queue, PopFilter filter) {
+    if (congested())
+        absorb(queue, filter);
+}
+
+/*
+ * Pick the next message to send. While behind, high priority messages are
+ * sent straight from the queue and only conflatable regular messages are
+ * held back in the staging slots
+ */
+bool FlowControl::next(IMessageQueue& queue, Message& message, std::chrono::milliseconds timeout,
+                       PopFilter filter) {
+    // Keeping up: send in queue order
+    if (!congested() && !hasStaged())
+        return queue.tryPop(message, timeout, filter);
+
+    if (congested()) {
+        if (filter != PopFilter::RegularOnly
+            && queue.tryPop(message, std::chrono::milliseconds(0), PopFilter::PriorityOnly))
+            return true;
+
+        absorb(queue, filter);
+        if (!hasStaged()) {
+            if (!queue.tryPop(message, timeout, filter))
+                return false;
+            if (!conflatable(message))
+                return true;
+            stage(message);
+            absorb(queue, filter);
+        }
+    }
+
+    // Staged messages go out before anything newer in the queue
+    return takeStaged(message);
+}
+
+// Put staged messages back so the next session can deliver them
+void FlowControl::requeueAll(IMessageQueue& queue) {
+    // requeue() puts at the front, so return them newest first. There are at
+    // most three, well within the queue's requeue reserve
+    Message message;
+    std::vector<Message> staged;
+    while (takeStaged(message))
+        staged.push_back(message);
+    for (auto it = staged.rbegin(); it != staged.rend(); ++it)
+        queue.requeue(*it);
+}
+
+/*
+ * Conflate the regular messages immediately available, stopping at one that
+ * may not be conflated; it is only checked in place, never popped. High
+ * priority messages are left in the queue for whichever session is free
+ */
+void FlowControl::absorb(IMessageQueue& queue, PopFilter filter) {
+    if (filter == PopFilter::PriorityOnly)
+        return;
+
+    std::function<bool(const Message&)> accept = [this](const Message& message) {
+        return conflatable(message);
+    };
+    Message message;
+    while (queue.tryPopIf(message, PopFilter::RegularOnly, accept))
+        stage(message);
+}
+
+// Returns if a message is regular priority of a format conflated while behind
+bool FlowControl::conflatable(const Message& message) const {
+    int format = static_cast<int>(message.getFormat());
+    return !message.isHighPriority() && format >= 0 && format < 3 && m_config.conflate[format];
+}
+
+// Keep only the newest staged message of its format
+void FlowControl::stage(const Message& message) {
+    int format = static_cast<int>(message.getFormat());
+    if (m_hasLatest[format])
+        m_conflated.fetch_add(1, std::memory_order_relaxed);
+    m_latest[format] = { message, m_order++ };
+    m_hasLatest[format] = true;
+}
+
+// Whichever staged message was popped first
+bool FlowControl::takeStaged(Message& message) {
+    int best = -1;
+    uint64_t bestOrder = UINT64_MAX;
+    for (int format = 0; format < 3; ++format) {
+        if (m_hasLatest[format] && m_latest[format].order < bestOrder) {
+            best = format;
+            bestOrder = m_latest[format].order;
+        }
+    }
+
+    if (best < 0)
+        return false;
+    message = m_latest[best].message;
+    m_hasLatest[best] = false;
+    return true;
+}
+
+// Returns if anything is staged
+bool FlowControl::hasStaged() const {
+    return m_hasLatest[0] || m_hasLatest[1] || m_hasLatest[2];
+}
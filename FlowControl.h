@@ -0,0 +1,156 @@
+#ifndef FLOW_CONTROL_H
+#define FLOW_CONTROL_H
+
+#include "IMessageQueue.h"
+#include "MessageQueue.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma once
+
+// Thresholds for switching a session between normal and conflated delivery
+struct FlowControlConfig {
+    size_t pendingHigh = 8 * 1024;     // Unsent bytes in the socket that mark the session as behind
+    size_t pendingLow = 2 * 1024;      // Unsent bytes below which it has caught up
+    std::chrono::milliseconds writeHigh { 20 }; // Smoothed write completion time that marks it as behind
+    std::chrono::milliseconds writeLow { 5 };   // Smoothed write completion time below which it has caught up
+    size_t sendBuffer = 0;             // SO_SNDBUF for sessions in bytes (0 = OS default)
+
+    // Regular-priority formats that may be conflated to their latest value
+    // while behind. High priority messages are never conflated or delayed
+    bool conflate[3] = { true, true, false }; // wheel, arm, science tool
+};
+
+// Per-session congestion tracking and conflated delivery.
+//
+// The IO thread reports write completions and the socket's unsent byte count;
+// the session thread asks next() for the message to send. While the session
+// keeps up, next() pops straight from the queue. Once it falls behind, next()
+// sends high priority messages first, straight from the queue, and pulls the
+// conflatable regular messages waiting behind them into one slot per format,
+// so the client receives fresh setpoints instead of a backlog. Everything else
+// stays in the queue, where other sessions can still deliver it.
+class FlowControl {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** Constructor for FlowControl
+     *
+     * @param
+     *  config: FlowControlConfig - The congestion thresholds
+     */
+    FlowControl(FlowControlConfig config = FlowControlConfig());
+
+    /** Records a completed write (IO thread)
+     *
+     * @param
+     *  elapsed: Clock::duration - Time from starting the write to its completion
+     *  pendingBytes: size_t - Bytes still unsent in the socket afterwards
+     *
+     * @return
+     *  none
+     */
+    void onWriteComplete(Clock::duration elapsed, size_t pendingBytes);
+
+    /** Records the socket's unsent byte count while idle (IO thread)
+     *
+     * @param
+     *  pendingBytes: size_t - Bytes still unsent in the socket
+     *
+     * @return
+     *  none
+     */
+    void onPendingBytes(size_t pendingBytes);
+
+    /** Records a write that has been outstanding for a while (session thread).
+     * A write stuck behind a full socket marks the session as behind before it completes
+     *
+     * @param
+     *  inFlight: Clock::duration - Time since the write was started
+     *
+     * @return
+     *  none
+     */
+    void onWriteStalled(Clock::duration inFlight);
+
+    /** Conflates whatever is waiting in the queue while a write is outstanding,
+     * so the queue does not fill up behind a slow client (session thread)
+     *
+     * @param
+     *  queue: IMessageQueue& - The queue feeding the session
+     *  filter: PopFilter - The lanes of the queue this session serves
+     *
+     * @return
+     *  none
+     */
+    void hold(IMessageQueue& queue, PopFilter filter = PopFilter::Any);
+
+    /** Returns the next message to send (session thread)
+     *
+     * @param
+     *  queue: IMessageQueue& - The queue feeding the session
+     *  message: Message& - Receives the message to send
+     *  timeout: std::chrono::milliseconds - How long to wait for a message
+     *  filter: PopFilter - The lanes of the queue this session serves
+     *
+     * @return
+     *  bool - True if a message was returned, False on timeout
+     */
+    bool next(IMessageQueue& queue, Message& message, std::chrono::milliseconds timeout,
+              PopFilter filter = PopFilter::Any);
+
+    /** Puts every message held back by conflation back into the queue
+     * (session thread, when the link dies)
+     *
+     * @param
+     *  queue: IMessageQueue& - The queue feeding the session
+     *
+     * @return
+     *  none
+     */
+    void requeueAll(IMessageQueue& queue);
+
+    bool congested() const { return m_congested.load(std::memory_order_relaxed); }
+    uint64_t conflated() const { return m_conflated.load(std::memory_order_relaxed); }
+    size_t pendingBytes() const { return m_pending.load(std::memory_order_relaxed); }
+    const FlowControlConfig& config() const { return m_config; }
+
+private:
+    // Re-evaluate congestion with hysteresis (IO thread)
+    void update();
+
+    // Move the conflatable regular messages available in the queue into the staging slots
+    void absorb(IMessageQueue& queue, PopFilter filter);
+    bool conflatable(const Message& message) const;
+    void stage(const Message& message);
+
+    // Take the next staged message in pop order
+    bool takeStaged(Message& message);
+    bool hasStaged() const;
+
+    FlowControlConfig m_config;
+
+    // Written by the IO thread, read by any thread
+    std::atomic<bool> m_congested { false };
+    std::atomic<size_t> m_pending { 0 };
+    std::atomic<uint64_t> m_conflated { 0 };
+    int64_t m_writeEwmaUs = 0;  // Smoothed write completion time (IO thread only)
+
+    // Staging used while congested (session thread only)
+    struct Staged {
+        Message message;
+        uint64_t order;   // Pop order, to keep the formats in sequence
+    };
+    std::array<Staged, 3> m_latest;               // Newest message per conflatable format
+    std::array<bool, 3> m_hasLatest = { false, false, false };
+    uint64_t m_order = 0;
+
+    // requeueAll() must never need more than the queue holds back for requeues
+    static_assert(std::tuple_size<decltype(m_latest)>::value <= QUEUE_REQUEUE_RESERVE,
+                  "staged messages must fit in the requeue reserve");
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "Heartbeat.h"
+#include <algorithm>
+#include <string>
+
+// Constructor
+Heartbeat::Heartbeat(HeartbeatConfig config) :
+    m_config(config), m_lastHeard(Clock::now()), m_lastPong(m_lastHeard),
+    m_pingOutstanding(false), m_pingId(0), m_srtt(-1) { }
+
+// Any frame from the peer proves the link is alive
+void Heartbeat::onActivity(Clock::time_point now) { m_lastHeard = now; }
+
+// Update the RTT estimate from a pong answering the outstanding ping
+void Heartbeat::onPong(boost::beast::string_view payload, Clock::time_point now) {
+    onActivity(now);
+
+    if (!m_pingOutstanding || payload != std::to_string(m_pingId))
+        return;
+
+    m_pingOutstanding = false;
+    m_lastPong = now;
+
+    // Exponentially weighted moving average with gain 1/8 (as in TCP's SRTT)
+    int64_t sample = std::chrono::duration_cast<std::chrono::microseconds>(now - m_pingSent).count();
+    int64_t srtt = m_srtt.load(std::memory_order_relaxed);
+    srtt = (srtt < 0) ? sample : srtt + (sample - srtt) / 8;
+    m_srtt.store(srtt, std::memory_order_relaxed);
+}
+
+// Ping once per idle interval so the RTT keeps updating under traffic
+bool Heartbeat::shouldPing(Clock::time_point now) const {
+    return !m_pingOutstanding && now - m_lastPong >= m_config.idle;
+}
+
+// Mark a ping as outstanding and return its payload
+boost::beast::websocket::ping_data Heartbeat::ping(Clock::time_point now) {
+    m_pingOutstanding = true;
+    m_pingSent = now;
+    ++m_pingId;
+
+    std::string id = std::to_string(m_pingId);
+    return boost::beast::websocket::ping_data(id.data(), id.size());
+}
+
+// A late pong is fine as long as data is still arriving (e.g. pong queued
+// behind a backlog); the link is only dead when the peer went fully silent
+bool Heartbeat::expired(Clock::time_point now) const {
+    return m_pingOutstanding
+        && now - std::max(m_pingSent, m_lastHeard) >= m_config.timeout;
+}
+
+// Check often enough to detect a timeout within a fraction of its threshold
+std::chrono::milliseconds Heartbeat::checkInterval() const {
+    auto interval = std::min(m_config.idle, m_config.timeout) / 4;
+    return std::max(interval, std::chrono::milliseconds(5));
+}
+
+// Smoothed RTT in microseconds
+std::chrono::microseconds Heartbeat::rtt() const {
+    return std::chrono::microseconds(m_srtt.load(std::memory_order_relaxed));
+}
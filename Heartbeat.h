@@ -0,0 +1,108 @@
+#pragma once
+#include <boost/beast/websocket.hpp>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+// Thresholds for WebSocket ping/pong liveness checks
+struct HeartbeatConfig {
+    std::chrono::milliseconds idle { 100 };    // Time since the last pong before another ping is sent
+    std::chrono::milliseconds timeout { 300 }; // Silence after a ping before the link is declared dead
+};
+
+// Tracks ping/pong state and a smoothed round trip time for one connection.
+// All methods except rtt() must be called from the thread driving the
+// connection; rtt() may be read from any thread.
+class Heartbeat {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** Constructor for Heartbeat
+     *
+     * @param
+     *  config: HeartbeatConfig - The idle and timeout thresholds
+     */
+    Heartbeat(HeartbeatConfig config = HeartbeatConfig());
+
+    /** Records that a frame was received from the peer
+     *
+     * @param
+     *  now: Clock::time_point - The time the frame arrived
+     *
+     * @return
+     *  none
+     */
+    void onActivity(Clock::time_point now);
+
+    /** Records a pong from the peer and updates the RTT estimate if it
+     * answers the outstanding ping
+     *
+     * @param
+     *  payload: boost::beast::string_view - The payload of the pong frame
+     *  now: Clock::time_point - The time the pong arrived
+     *
+     * @return
+     *  none
+     */
+    void onPong(boost::beast::string_view payload, Clock::time_point now);
+
+    /** Returns if a ping should be sent now
+     *
+     * @param
+     *  now: Clock::time_point - The current time
+     *
+     * @return
+     *  bool - True if no ping is outstanding and the idle threshold has passed
+     */
+    bool shouldPing(Clock::time_point now) const;
+
+    /** Marks a ping as sent and returns the payload to send with it
+     *
+     * @param
+     *  now: Clock::time_point - The time the ping is sent
+     *
+     * @return
+     *  boost::beast::websocket::ping_data - The ping payload
+     */
+    boost::beast::websocket::ping_data ping(Clock::time_point now);
+
+    /** Returns if the link should be considered dead
+     *
+     * @param
+     *  now: Clock::time_point - The current time
+     *
+     * @return
+     *  bool - True if a ping is outstanding and nothing has been heard from
+     *         the peer within the timeout
+     */
+    bool expired(Clock::time_point now) const;
+
+    /** Returns how often shouldPing() and expired() should be checked
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  std::chrono::milliseconds - The check interval
+     */
+    std::chrono::milliseconds checkInterval() const;
+
+    /** Returns the smoothed round trip time
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  std::chrono::microseconds - The smoothed RTT, or -1 before the first pong
+     */
+    std::chrono::microseconds rtt() const;
+
+private:
+    HeartbeatConfig m_config;
+    Clock::time_point m_lastHeard;    // Last frame of any kind from the peer
+    Clock::time_point m_lastPong;     // Last answered ping (or start)
+    Clock::time_point m_pingSent;     // When the outstanding ping was sent
+    bool m_pingOutstanding;
+    uint64_t m_pingId;                // Identifies the outstanding ping
+    std::atomic<int64_t> m_srtt;      // Smoothed RTT in microseconds (-1 if unknown)
+};
@@ -0,0 +1,104 @@
+#ifndef IMESSAGE_QUEUE_H
+#define IMESSAGE_QUEUE_H
+
+#include "Message.h"
+#include <chrono>
+#include <functional>
+#include <stddef.h>
+
+#pragma once
+
+// Which messages a pop may return
+enum class PopFilter {
+    Any,            // High priority first, then regular
+    PriorityOnly,   // Only high priority messages
+    RegularOnly,    // Only regular messages
+};
+
+// Operations the server and producers need from a queue of messages.
+// Implemented by MessageQueue (single lock) and ShardedMessageQueue.
+class IMessageQueue {
+public:
+    virtual ~IMessageQueue() = default;
+
+    /** Add message into correct queue depending on priority
+     *
+     * @param
+     * message (Message): the Message object being added to the queue
+     *
+     * @return
+     * (bool) if the message was queued (True) or discarded (False)
+     */
+    virtual bool push(const Message message) = 0;
+
+    /** Remove the next message, high priority first (blocks if empty)
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (Message) the Message object in the front of the queue
+     */
+    virtual Message pop() = 0;
+
+    /** Remove the next message, waiting at most `timeout` for one
+     *
+     * @param
+     * message (Message&): receives the popped Message object
+     * timeout (std::chrono::milliseconds): how long to wait for a message
+     * filter (PopFilter): restrict the pop to one lane (default either)
+     *
+     * @return
+     * (bool) if a message was popped (True) or the wait timed out (False)
+     */
+    virtual bool tryPop(Message& message, std::chrono::milliseconds timeout,
+                        PopFilter filter = PopFilter::Any) = 0;
+
+    /** Remove the front message of a lane without waiting, but only if
+     * `accept` returns true for it. Lanes are looked at in tryPop's order and
+     * only their front messages are checked; a rejected message stays where
+     * it is
+     *
+     * @param
+     * message (Message&): receives the popped Message object
+     * filter (PopFilter): restrict the pop to one lane
+     * accept (const std::function<bool(const Message&)>&): decides if a front message is taken
+     *
+     * @return
+     * (bool) if a message was popped (True) or none was accepted (False)
+     */
+    virtual bool tryPopIf(Message& message, PopFilter filter,
+                          const std::function<bool(const Message&)>& accept) = 0;
+
+    /** Put a popped message back so that it is the next one popped
+     *
+     * @param
+     * message (Message): the Message object being returned to the queue
+     *
+     * @return
+     * none
+     */
+    virtual void requeue(const Message message) = 0;
+
+    /** Returns how many elements are in the queue
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (size_t) the number of elements in the queue
+     */
+    virtual size_t size() = 0;
+
+    /** Returns if the queue is empty (True) or not (False)
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (bool) if the queue is empty (True) or not (False)
+     */
+    virtual bool empty() = 0;
+};
+
+#endif
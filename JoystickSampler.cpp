@@ -0,0 +1,216 @@
+#include "JoystickSampler.h"
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+
+// Compare two setpoints field by field
+static bool sameOutput(const WheelMessage& a, const WheelMessage& b) {
+    return a.velocity == b.velocity && a.theta == b.theta && a.angle_velocity == b.angle_velocity;
+}
+
+// Constructor
+JoystickSampler::JoystickSampler(IMessageQueue& queue, JoystickConfig config) :
+    m_queue(queue), m_config(config)
+{
+    m_config.step = std::max(m_config.step, 1);
+    m_config.deadband = std::clamp(m_config.deadband, 0, JOYSTICK_AXIS_MAX - 1);
+    m_thread = std::thread(&JoystickSampler::run, this);
+}
+
+// Destructor
+JoystickSampler::~JoystickSampler() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+}
+
+// Route both sticks into this sampler
+void JoystickSampler::bind(buttonFunctions& controls) {
+    controls.LEFT_JOYSTICK = [this](int xValue, int yValue) { left(xValue, yValue); };
+    controls.RIGHT_JOYSTICK = [this](int xValue, int yValue) { right(xValue, yValue); };
+}
+
+// New left stick position
+void JoystickSampler::left(int xValue, int yValue) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_leftX = xValue;
+    m_leftY = yValue;
+    update(Clock::now());
+}
+
+// New right stick position
+void JoystickSampler::right(int xValue, int yValue) {
+    (void)yValue;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rightX = xValue;
+    update(Clock::now());
+}
+
+// Last setpoint pushed
+WheelMessage JoystickSampler::lastSent() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sent;
+}
+
+// Counters so far
+JoystickSampler::Stats JoystickSampler::stats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+/*
+ * Zero inside the deadband, then linear up to outputMax at full deflection.
+ * The level only moves once the input is a full step away from it
+ */
+int JoystickSampler::shape(int raw, int level) const {
+    int64_t magnitude = std::min<int64_t>(std::abs(static_cast<int64_t>(raw)), JOYSTICK_AXIS_MAX);
+    int64_t scaled = 0;
+    if (magnitude > m_config.deadband) {
+        scaled = (magnitude - m_config.deadband) * m_config.outputMax
+               / (JOYSTICK_AXIS_MAX - m_config.deadband);
+    }
+
+    int value = static_cast<int>(raw < 0 ? -scaled : scaled);
+    if (std::abs(value - level) < m_config.step)
+        return level;
+
+    int quantized = std::min(static_cast<int>((scaled + m_config.step / 2) / m_config.step * m_config.step),
+                             m_config.outputMax);
+    return raw < 0 ? -quantized : quantized;
+}
+
+/*
+ * Send a change at once if the last push was long enough ago, otherwise leave
+ * it for the sending thread. A newer change replaces one that is waiting
+ */
+void JoystickSampler::update(Clock::time_point now) {
+    ++m_stats.samples;
+
+    WheelMessage previous = m_output;
+    m_output.velocity = shape(-m_leftY, m_output.velocity);   // Up is negative on the Y axis
+    m_output.theta = shape(m_leftX, m_output.theta);
+    m_output.angle_velocity = shape(m_rightX, m_output.angle_velocity);
+
+    // Back to what the rover already has: nothing to send
+    if (m_hasSent && sameOutput(m_output, m_sent)) {
+        if (m_pending) {
+            m_pending = false;
+            ++m_stats.coalesced;
+        }
+        return;
+    }
+
+    if (m_pending) {
+        if (!sameOutput(previous, m_output))
+            ++m_stats.coalesced;
+        return;
+    }
+
+    if (!m_hasSent || now - m_lastSend >= m_config.minInterval) {
+        send(now, false);
+        return;
+    }
+
+    m_pending = true;
+    m_cond.notify_one();
+}
+
+// Push the current output, retrying after minInterval if the queue is full
+void JoystickSampler::send(Clock::time_point now, bool heartbeat) {
+    m_lastSend = now;
+    if (!m_queue.push(Message(m_config.priority, m_output))) {
+        ++m_stats.dropped;
+        m_pending = true;
+        m_cond.notify_one();
+        return;
+    }
+
+    m_sent = m_output;
+    m_hasSent = true;
+    m_pending = false;
+    ++m_stats.sent;
+    if (heartbeat)
+        ++m_stats.heartbeats;
+}
+
+/*
+ * Send waiting changes once minInterval has passed, and heartbeats once the
+ * output has been quiet for the heartbeat interval
+ */
+void JoystickSampler::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping) {
+        auto now = Clock::now();
+        if (m_pending && now - m_lastSend >= m_config.minInterval)
+            send(now, false);
+        else if (!m_pending && m_hasSent && now - m_lastSend >= m_config.heartbeat)
+            send(now, true);
+
+        if (m_pending)
+            m_cond.wait_until(lock, m_lastSend + m_config.minInterval);
+        else if (m_hasSent)
+            m_cond.wait_until(lock, m_lastSend + m_config.heartbeat);
+        else
+            m_cond.wait(lock);
+    }
+}
+
+// Constructor
+SimulatedJoystick::SimulatedJoystick(buttonFunctions& controls, unsigned seed) :
+    m_controls(controls), m_random(seed) { }
+
+// Poll at a fixed rate, reporting both sticks each time
+uint64_t SimulatedJoystick::run(std::chrono::milliseconds duration, std::chrono::milliseconds poll) {
+    auto next = std::chrono::steady_clock::now();
+    auto end = next + duration;
+    uint64_t polls = 0;
+
+    while (next < end) {
+        int values[4];
+        for (int i = 0; i < 4; ++i)
+            values[i] = step(m_axes[i]);
+
+        if (m_controls.LEFT_JOYSTICK)
+            m_controls.LEFT_JOYSTICK(values[0], values[1]);
+        if (m_controls.RIGHT_JOYSTICK)
+            m_controls.RIGHT_JOYSTICK(values[2], values[3]);
+        ++polls;
+
+        next += poll;
+        std::this_thread::sleep_until(next);
+    }
+    return polls;
+}
+
+/*
+ * Hold, then pick a new target (center about half the time) and sweep to it.
+ * Readings carry some noise, as real sticks do
+ */
+int SimulatedJoystick::step(Axis& axis) {
+    if (axis.position == axis.target) {
+        if (axis.holdPolls > 0) {
+            --axis.holdPolls;
+        } else {
+            std::uniform_int_distribution<int> anywhere(-JOYSTICK_AXIS_MAX, JOYSTICK_AXIS_MAX);
+            std::uniform_int_distribution<int> sweepPolls(50, 400);
+            axis.target = (m_random() % 2 == 0) ? 0 : anywhere(m_random);
+            axis.speed = std::max(std::abs(axis.target - axis.position) / sweepPolls(m_random), 1.0);
+        }
+    } else {
+        double delta = axis.target - axis.position;
+        if (std::abs(delta) <= axis.speed) {
+            std::uniform_int_distribution<int> holdPolls(200, 3000);
+            axis.position = axis.target;
+            axis.holdPolls = holdPolls(m_random);
+        } else {
+            axis.position += std::copysign(axis.speed, delta);
+        }
+    }
+
+    std::normal_distribution<double> noise(0.0, 150.0);
+    double reading = axis.position + noise(m_random);
+    return static_cast<int>(std::clamp(reading, -32768.0, static_cast<double>(JOYSTICK_AXIS_MAX)));
+}
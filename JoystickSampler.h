@@ -0,0 +1,199 @@
+#ifndef JOYSTICK_SAMPLER_H
+#define JOYSTICK_SAMPLER_H
+
+#define JOYSTICK_AXIS_MAX 32767 // Largest raw axis value (SDL game controller range)
+
+#include "IMessageQueue.h"
+#include "Message.h"
+#include "pub_general.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <stdint.h>
+#include <thread>
+
+#pragma once
+
+// How raw stick positions become WheelMessages
+struct JoystickConfig {
+    int deadband = 4000;        // Raw values this close to center read as zero
+    int outputMax = 100;        // Output at full deflection
+    int step = 5;               // Output is quantized to multiples of this
+    std::chrono::milliseconds minInterval { 20 };   // Changes closer together than this are coalesced
+    std::chrono::milliseconds heartbeat { 250 };    // Unchanged output is re-sent this often
+    int priority = MESSAGE_PRIORITY_LOW;
+};
+
+// Producer stage turning controller input into WheelMessages.
+//
+// Left stick Y drives velocity (up is forward), left stick X theta, and right
+// stick X angle_velocity. Each axis goes through a deadband, is rescaled so
+// the output starts at zero at the edge of the deadband, and is quantized to
+// `step`. A quantized level only changes once the input has moved a full
+// step away from it, so sensor noise at a boundary does not flicker.
+//
+// A message is pushed only when the output changes, or after `heartbeat`
+// without a change so the rover knows the link is alive. The first change
+// after a quiet period goes out at once, from the thread reporting the input;
+// further changes within `minInterval` are coalesced and only the newest is
+// sent when the interval is up. A push refused by a full queue is retried
+// after `minInterval`.
+//
+// Example Usage:
+//   buttonFunctions controls;
+//   JoystickSampler sampler(queue);
+//   sampler.bind(controls);   // controls.LEFT_JOYSTICK(x, y) now feeds the queue
+class JoystickSampler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Counters since construction
+    struct Stats {
+        uint64_t samples = 0;      // Stick positions reported
+        uint64_t sent = 0;         // Messages pushed (including heartbeats)
+        uint64_t heartbeats = 0;   // Pushes of unchanged output
+        uint64_t coalesced = 0;    // Changes replaced by a newer one before they were sent
+        uint64_t dropped = 0;      // Pushes refused by the queue
+    };
+
+    /** Constructor for JoystickSampler. Starts the thread sending coalesced
+     * changes and heartbeats
+     *
+     * @param
+     *  queue: IMessageQueue& - Where WheelMessages are pushed; must outlive the sampler
+     *  config: JoystickConfig - Deadband, quantization and rate limits
+     */
+    JoystickSampler(IMessageQueue& queue, JoystickConfig config = JoystickConfig());
+
+    // Stops the sending thread
+    ~JoystickSampler();
+
+    JoystickSampler(const JoystickSampler&) = delete;
+    JoystickSampler& operator=(const JoystickSampler&) = delete;
+
+    /** Points the controller's stick callbacks at this sampler
+     *
+     * @param
+     *  controls: buttonFunctions& - The controller mapping to fill in
+     *
+     * @return
+     *  none
+     */
+    void bind(buttonFunctions& controls);
+
+    /** Reports a left stick position
+     *
+     * @param
+     *  xValue: int - Raw X axis (-32768 to 32767)
+     *  yValue: int - Raw Y axis (-32768 to 32767, negative is up)
+     *
+     * @return
+     *  none
+     */
+    void left(int xValue, int yValue);
+
+    /** Reports a right stick position. Only the X axis is used
+     *
+     * @param
+     *  xValue: int - Raw X axis (-32768 to 32767)
+     *  yValue: int - Raw Y axis (ignored)
+     *
+     * @return
+     *  none
+     */
+    void right(int xValue, int yValue);
+
+    /** Returns the output that was last pushed
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  WheelMessage - The last setpoint sent (zero before the first)
+     */
+    WheelMessage lastSent();
+
+    Stats stats();
+
+private:
+    // Deadband, rescale and quantize one axis against its current level
+    int shape(int raw, int level) const;
+
+    // Recompute the output after an input changed (m_mutex held)
+    void update(Clock::time_point now);
+
+    // Push the current output (m_mutex held)
+    void send(Clock::time_point now, bool heartbeat);
+
+    // Sending thread body
+    void run();
+
+    IMessageQueue& m_queue;
+    JoystickConfig m_config;
+
+    std::mutex m_mutex;               // Guards everything below
+    std::condition_variable m_cond;
+    int m_leftX = 0;                  // Latest raw input
+    int m_leftY = 0;
+    int m_rightX = 0;
+    WheelMessage m_output {};         // Shaped output of the latest input
+    WheelMessage m_sent {};           // Output last pushed
+    bool m_hasSent = false;
+    bool m_pending = false;           // m_output differs from m_sent and is waiting for minInterval
+    Clock::time_point m_lastSend;     // Time of the last push attempt
+    Stats m_stats;
+    bool m_stopping = false;
+
+    std::thread m_thread;
+};
+
+// Stand-in for a game controller, for testing without hardware.
+//
+// Calls the LEFT_JOYSTICK and RIGHT_JOYSTICK callbacks at a fixed poll rate,
+// like a controller read loop would. The sticks rest at center, hold
+// positions and sweep between them, with a little sensor noise throughout.
+//
+// Example Usage:
+//   SimulatedJoystick joystick(controls);
+//   joystick.run(std::chrono::seconds(10));
+class SimulatedJoystick {
+public:
+    /** Constructor for SimulatedJoystick
+     *
+     * @param
+     *  controls: buttonFunctions& - The callbacks to drive; must outlive the simulator
+     *  seed: unsigned - Seed for the generated motion
+     */
+    SimulatedJoystick(buttonFunctions& controls, unsigned seed = 1);
+
+    /** Polls the simulated sticks, blocking until duration has passed
+     *
+     * @param
+     *  duration: std::chrono::milliseconds - How long to run
+     *  poll: std::chrono::milliseconds - Time between polls (default 1ms, a 1kHz controller)
+     *
+     * @return
+     *  uint64_t - Number of polls made
+     */
+    uint64_t run(std::chrono::milliseconds duration,
+                 std::chrono::milliseconds poll = std::chrono::milliseconds(1));
+
+private:
+    // One stick axis moving between targets
+    struct Axis {
+        double position = 0;
+        double target = 0;
+        double speed = 0;      // Raw units per poll while sweeping
+        int holdPolls = 0;     // Polls left before picking a new target
+    };
+
+    // Advance an axis by one poll and return its raw reading
+    int step(Axis& axis);
+
+    buttonFunctions& m_controls;
+    std::mt19937 m_random;
+    Axis m_axes[4];            // Left X, left Y, right X, right Y
+};
+
+#endif
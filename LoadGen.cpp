@@ -0,0 +1,385 @@
+#include "WebsocketServer.h"
+#include "WebsocketClient.h"
+#include "ShardedMessageQueue.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+// Load generator for the WebSocket server.
+//
+// Starts a local WebSocketServer, runs a number of producer threads pushing a
+// configurable payload mix into its MessageQueue at a target rate, and a
+// number of WebSocketClients draining it. Reports throughput, drops and
+// end-to-end latency percentiles as CSV or JSON.
+//
+// Example Usage:
+//   ./bin/LoadGen --producers 4 --clients 8 --rate 20000 --duration 10
+//   ./bin/LoadGen --pattern bursty --burst 200 --output json --out run.json
+//   ./bin/LoadGen --producers 8 --shards 8 --rate 100000
+//   ./bin/LoadGen --producers 4 --clients 4 --channels 4 --rate 20000
+//   ./bin/LoadGen --trace 100 --trace-out trace.json
+
+using Clock = std::chrono::steady_clock;
+
+// Instrumented (PGO training) builds write their profile at exit, which
+// std::_Exit skips, so it is flushed explicitly. The hooks are weak so the
+// code is identical in instrumented and optimized builds
+#if defined(__clang__)
+extern "C" int __llvm_profile_write_file(void) __attribute__((weak));
+static void flushProfile() { if (__llvm_profile_write_file) __llvm_profile_write_file(); }
+#elif defined(__GNUC__)
+extern "C" void __gcov_dump(void) __attribute__((weak));
+static void flushProfile() { if (__gcov_dump) __gcov_dump(); }
+#else
+static void flushProfile() { }
+#endif
+
+struct LoadGenConfig {
+    int producers = 1;            // Producer threads pushing into the queue
+    int clients = 1;              // WebSocket clients connected to the server
+    double rate = 1000.0;         // Target total messages per second
+    double duration = 5.0;        // Seconds to produce for
+    double drain = 2.0;           // Seconds to wait for in-flight messages
+    bool bursty = false;          // Send in bursts instead of evenly spaced
+    int burst = 50;               // Messages per burst when bursty
+    int priorityPercent = 10;     // Share of high-priority messages
+    int shards = 0;               // ShardedMessageQueue shards (0 = MessageQueue)
+    int channels = 1;             // Server channels, each with its own queue
+    int mix[4] = { 4, 3, 2, 1 };  // Weights: wheel, arm, science tool, generic
+    unsigned short port = 9090;   // Port of the local server
+    bool json = false;            // Report as JSON instead of CSV
+    std::string out;              // Report file (stdout if empty)
+    int trace = 0;                // Trace one message in N (0 = off)
+    std::string traceOut = "trace.json"; // Chrome trace file when tracing
+};
+
+// Shared counters and push timestamps, indexed by message sequence number
+struct LoadGenState {
+    explicit LoadGenState(size_t capacity) :
+        capacity(capacity), pushTimes(new std::atomic<int64_t>[capacity]) {
+        for (size_t i = 0; i < capacity; ++i)
+            pushTimes[i].store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity;
+    std::unique_ptr<std::atomic<int64_t>[]> pushTimes; // ns since clock epoch
+    std::atomic<uint64_t> nextSeq { 0 };
+    std::atomic<uint64_t> accepted { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+    std::atomic<uint64_t> received { 0 };
+};
+
+// Per-client latency samples (microseconds)
+struct ClientSamples {
+    std::mutex mutex;
+    std::vector<double> latencies;
+};
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+static void printUsage() {
+    std::cerr
+        << "Usage: LoadGen [options]\n"
+        << "  --producers N      producer threads (default 1)\n"
+        << "  --clients N        WebSocket clients (default 1)\n"
+        << "  --rate R           total target messages/s (default 1000)\n"
+        << "  --duration S       seconds to produce for (default 5)\n"
+        << "  --drain S          seconds to wait for in-flight messages (default 2)\n"
+        << "  --pattern P        constant | bursty (default constant)\n"
+        << "  --burst N          messages per burst when bursty (default 50)\n"
+        << "  --priority PCT     percent of high-priority messages (default 10)\n"
+        << "  --shards N         use a ShardedMessageQueue with N shards (default 0 = MessageQueue)\n"
+        << "  --channels N       spread producers and clients over N channels (default 1)\n"
+        << "  --mix W:A:S:G      weights of wheel/arm/science/generic (default 4:3:2:1)\n"
+        << "  --port P           port of the local server (default 9090)\n"
+        << "  --output F         csv | json (default csv)\n"
+        << "  --out FILE         write the report to FILE instead of stdout\n"
+        << "  --trace N          trace one message in N (default 0 = off)\n"
+        << "  --trace-out FILE   Chrome trace JSON file (default trace.json)\n";
+}
+
+// Parse command line arguments, returning false on invalid input
+static bool parseArgs(int argc, char** argv, LoadGenConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string key = argv[i];
+        if (key == "--help" || key == "-h" || i + 1 >= argc)
+            return false;
+        std::string value = argv[++i];
+
+        try {
+            if (key == "--producers") cfg.producers = std::stoi(value);
+            else if (key == "--clients") cfg.clients = std::stoi(value);
+            else if (key == "--rate") cfg.rate = std::stod(value);
+            else if (key == "--duration") cfg.duration = std::stod(value);
+            else if (key == "--drain") cfg.drain = std::stod(value);
+            else if (key == "--burst") cfg.burst = std::stoi(value);
+            else if (key == "--priority") cfg.priorityPercent = std::stoi(value);
+            else if (key == "--shards") cfg.shards = std::stoi(value);
+            else if (key == "--channels") cfg.channels = std::stoi(value);
+            else if (key == "--port") cfg.port = static_cast<unsigned short>(std::stoi(value));
+            else if (key == "--out") cfg.out = value;
+            else if (key == "--trace") cfg.trace = std::stoi(value);
+            else if (key == "--trace-out") cfg.traceOut = value;
+            else if (key == "--pattern") {
+                if (value != "constant" && value != "bursty")
+                    return false;
+                cfg.bursty = (value == "bursty");
+            } else if (key == "--output") {
+                if (value != "csv" && value != "json")
+                    return false;
+                cfg.json = (value == "json");
+            } else if (key == "--mix") {
+                std::istringstream iss(value);
+                char sep;
+                iss >> cfg.mix[0] >> sep >> cfg.mix[1] >> sep >> cfg.mix[2] >> sep >> cfg.mix[3];
+                if (!iss)
+                    return false;
+            } else {
+                return false;
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    return cfg.producers > 0 && cfg.clients > 0 && cfg.rate > 0 && cfg.duration > 0
+        && cfg.burst > 0 && cfg.shards >= 0 && cfg.priorityPercent >= 0 && cfg.priorityPercent <= 100
+        && cfg.channels > 0 && cfg.channels <= cfg.clients && cfg.trace >= 0
+        && (cfg.mix[0] + cfg.mix[1] + cfg.mix[2] + cfg.mix[3]) > 0;
+}
+
+// Build a message of the given kind carrying the sequence number in its first field
+static Message makeMessage(int kind, bool highPriority, int seq) {
+    switch (kind) {
+        case 0:  return Message(highPriority, WheelMessage{seq, 45, 10});
+        case 1:  return Message(highPriority, ArmMessage{seq, 200, 300, 50, 60, 1, 90, 180});
+        case 2:  return Message(highPriority, ScienceToolMessage{seq, 1, 20, 30});
+        default: return Message(highPriority, Generic{seq});
+    }
+}
+
+// Recover the sequence number stored by makeMessage()
+static int sequenceOf(const Message& msg) {
+    return std::visit([](auto&& payload) -> int {
+        using T = std::decay_t<decltype(payload)>;
+        if constexpr (std::is_same_v<T, WheelMessage>)
+            return payload.velocity;
+        else if constexpr (std::is_same_v<T, ArmMessage>)
+            return payload.armXPos;
+        else if constexpr (std::is_same_v<T, ScienceToolMessage>)
+            return payload.moveUpDown;
+        else
+            return payload.value;
+    }, msg.getPayload());
+}
+
+// Push messages into the queue at this producer's share of the target rate
+static void runProducer(int id, const LoadGenConfig& cfg, IMessageQueue& queue, LoadGenState& state) {
+    std::mt19937 rng(1234u + id);
+    std::discrete_distribution<int> kindDist({ double(cfg.mix[0]), double(cfg.mix[1]),
+                                               double(cfg.mix[2]), double(cfg.mix[3]) });
+    std::uniform_int_distribution<int> pctDist(0, 99);
+
+    // Each producer sends `batch` messages every `period`
+    double perProducerRate = cfg.rate / cfg.producers;
+    int batch = cfg.bursty ? cfg.burst : 1;
+    auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(batch / perProducerRate));
+
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(cfg.duration));
+    auto next = start;
+
+    while (next < end) {
+        for (int i = 0; i < batch; ++i) {
+            uint64_t seq = state.nextSeq.fetch_add(1, std::memory_order_relaxed);
+            if (seq >= state.capacity)
+                return;
+
+            bool highPriority = pctDist(rng) < cfg.priorityPercent;
+            Message msg = makeMessage(kindDist(rng), highPriority, static_cast<int>(seq));
+
+            state.pushTimes[seq].store(nowNs(), std::memory_order_relaxed);
+            if (queue.push(msg))
+                state.accepted.fetch_add(1, std::memory_order_relaxed);
+            else
+                state.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+// Handshake target of a channel ("/" when there is only one)
+static std::string channelTarget(const LoadGenConfig& cfg, int channel) {
+    return cfg.channels == 1 ? "/" : "/channel" + std::to_string(channel);
+}
+
+// Receive messages and record their end-to-end latency
+static void runClient(const LoadGenConfig& cfg, const std::string& target, LoadGenState& state,
+                      ClientSamples& samples) {
+    try {
+        WebSocketClient client("127.0.0.1", std::to_string(cfg.port), target);
+        client.connect();
+
+        while (true) {
+            Message msg = client.receive();
+            int64_t received = nowNs();
+
+            int seq = sequenceOf(msg);
+            if (seq < 0 || static_cast<size_t>(seq) >= state.capacity)
+                continue;
+
+            int64_t pushed = state.pushTimes[seq].load(std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(samples.mutex);
+                samples.latencies.push_back((received - pushed) / 1000.0);
+            }
+            state.received.fetch_add(1, std::memory_order_relaxed);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Client disconnect: " << e.what() << "\n";
+    }
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const std::vector<double>& sorted, double pct) {
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = static_cast<size_t>(pct / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+int main(int argc, char** argv) {
+    LoadGenConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    // Size the timestamp table for the whole run, with headroom for bursts
+    size_t capacity = static_cast<size_t>(cfg.rate * cfg.duration * 1.1)
+        + static_cast<size_t>(cfg.producers) * cfg.burst + 1024;
+    LoadGenState state(capacity);
+    Tracer::instance().setSampling(static_cast<uint32_t>(cfg.trace));
+
+    // One queue per channel
+    WebSocketServer server(cfg.port, false);
+    std::vector<std::unique_ptr<IMessageQueue>> queues;
+    for (int i = 0; i < cfg.channels; ++i) {
+        if (cfg.shards > 0)
+            queues.push_back(std::make_unique<ShardedMessageQueue>(cfg.shards));
+        else
+            queues.push_back(std::make_unique<MessageQueue>());
+        server.addChannel(channelTarget(cfg, i), *queues.back());
+    }
+
+    // The server and its sessions block forever, so they run detached
+    std::thread([&server]() { server.run(); }).detach();
+
+    std::vector<std::string> targets;
+    std::vector<std::unique_ptr<ClientSamples>> samples;
+    for (int i = 0; i < cfg.clients; ++i)
+        targets.push_back(channelTarget(cfg, i % cfg.channels));
+    for (int i = 0; i < cfg.clients; ++i) {
+        samples.push_back(std::make_unique<ClientSamples>());
+        std::thread(runClient, std::cref(cfg), std::cref(targets[i]), std::ref(state),
+                    std::ref(*samples.back())).detach();
+    }
+
+    // Give the clients time to complete their handshakes
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto start = Clock::now();
+    std::vector<std::thread> producers;
+    for (int i = 0; i < cfg.producers; ++i)
+        producers.emplace_back(runProducer, i, std::cref(cfg), std::ref(*queues[i % cfg.channels]),
+                               std::ref(state));
+    for (auto& producer : producers)
+        producer.join();
+    auto produced = Clock::now();
+
+    // Wait for queued messages to reach the clients
+    auto drainEnd = produced + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(cfg.drain));
+    while (Clock::now() < drainEnd
+           && state.received.load() < state.accepted.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double produceTime = std::chrono::duration<double>(produced - start).count();
+
+    std::vector<double> latencies;
+    for (auto& s : samples) {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        latencies.insert(latencies.end(), s->latencies.begin(), s->latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    uint64_t accepted = state.accepted.load();
+    uint64_t dropped = state.dropped.load();
+    uint64_t received = state.received.load();
+    uint64_t lost = accepted > received ? accepted - received : 0;
+    double offeredRate = (accepted + dropped) / produceTime;
+    double throughput = received / elapsed;
+
+    std::ofstream file;
+    if (!cfg.out.empty())
+        file.open(cfg.out);
+    std::ostream& os = cfg.out.empty() ? std::cout : file;
+
+    if (cfg.json) {
+        os << "{\"producers\":" << cfg.producers
+           << ",\"clients\":" << cfg.clients
+           << ",\"shards\":" << cfg.shards
+           << ",\"channels\":" << cfg.channels
+           << ",\"pattern\":\"" << (cfg.bursty ? "bursty" : "constant") << "\""
+           << ",\"target_rate\":" << cfg.rate
+           << ",\"offered_rate\":" << offeredRate
+           << ",\"throughput\":" << throughput
+           << ",\"accepted\":" << accepted
+           << ",\"dropped\":" << dropped
+           << ",\"received\":" << received
+           << ",\"lost\":" << lost
+           << ",\"latency_us\":{\"p50\":" << percentile(latencies, 50)
+           << ",\"p90\":" << percentile(latencies, 90)
+           << ",\"p99\":" << percentile(latencies, 99)
+           << ",\"p999\":" << percentile(latencies, 99.9)
+           << ",\"max\":" << (latencies.empty() ? 0.0 : latencies.back())
+           << "}}" << std::endl;
+    } else {
+        os << "producers,clients,shards,channels,pattern,target_rate,offered_rate,throughput,"
+              "accepted,dropped,received,lost,p50_us,p90_us,p99_us,p999_us,max_us\n"
+           << cfg.producers << "," << cfg.clients << "," << cfg.shards << "," << cfg.channels << ","
+           << (cfg.bursty ? "bursty" : "constant") << ","
+           << cfg.rate << "," << offeredRate << "," << throughput << ","
+           << accepted << "," << dropped << "," << received << "," << lost << ","
+           << percentile(latencies, 50) << "," << percentile(latencies, 90) << ","
+           << percentile(latencies, 99) << "," << percentile(latencies, 99.9) << ","
+           << (latencies.empty() ? 0.0 : latencies.back()) << std::endl;
+    }
+    file.close();
+
+    if (cfg.trace > 0) {
+        std::ofstream traceFile(cfg.traceOut);
+        size_t events = Tracer::instance().dump(traceFile);
+        std::cerr << "Wrote " << events << " trace events to " << cfg.traceOut << "\n";
+    }
+
+    // Sessions and client reads have no shutdown path, so skip unwinding them
+    std::cerr.flush();
+    flushProfile();
+    std::_Exit(EXIT_SUCCESS);
+}
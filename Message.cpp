@@ -1,10 +1,33 @@
 #include "Message.h"
+#include "TextCodec.h"
+#include "Tracer.h"
+#include <stdexcept>
+
+static_assert(sizeof(EncodedBytes) + sizeof(EncodedBytes::ControlBlockBound) <= BUFFER_POOL_BLOCK_SIZE,
+              "EncodedBytes and its shared_ptr control block must fit one pool block");
+
+// Encode a message into the inline storage, or the heap if it does not fit
+EncodedBytes::EncodedBytes(const Message& msg) {
+    m_size = msg.serializeTo(m_inline, INLINE_SIZE);
+    m_data = m_inline;
+
+    if (m_size > INLINE_SIZE) {
+        m_heap.reset(new char[m_size]);
+        msg.serializeTo(m_heap.get(), m_size);
+        m_data = m_heap.get();
+    }
+}
 
 // Constructor
 Message::Message(int prty, MessagePayload payload) :
-    m_isHighPriority(prty), m_payload(std::move(payload))
+    m_isHighPriority(prty), m_payload(std::move(payload)), m_origin(0), m_traceId(0),
+    m_sequence(0)
 {
-    // Set m_format based on the payload type
+    updateFormat();
+}
+
+// Set m_format based on the payload type
+void Message::updateFormat() {
     std::visit([this](auto&& arg) {
         using T = std::decay_t<decltype(arg)>;
 
@@ -20,11 +43,18 @@ Message::Message(int prty, MessagePayload payload) :
 }
 
 // Default Constructor
-Message::Message() : m_isHighPriority(0), m_payload(Generic{0}), m_format(static_cast<MessageFormat>(-1)) {}
+Message::Message() : m_isHighPriority(0), m_payload(Generic{0}), m_format(static_cast<MessageFormat>(-1)),
+    m_origin(0), m_traceId(0), m_sequence(0) {}
 
-// Copy Constructor
+// Copy Constructor (shares the cached encoding)
 Message::Message(Message const& src) :
-    m_isHighPriority(src.m_isHighPriority), m_payload(src.m_payload), m_format(src.m_format) { }
+    m_isHighPriority(src.m_isHighPriority), m_payload(src.m_payload), m_format(src.m_format),
+    m_origin(src.m_origin), m_traceId(src.m_traceId), m_sequence(src.m_sequence), m_encoded(src.m_encoded) { }
+
+// Move Constructor (takes the cached encoding without touching its count)
+Message::Message(Message&& src) noexcept :
+    m_isHighPriority(src.m_isHighPriority), m_payload(std::move(src.m_payload)), m_format(src.m_format),
+    m_origin(src.m_origin), m_traceId(src.m_traceId), m_sequence(src.m_sequence), m_encoded(std::move(src.m_encoded)) { }
 
 // Destructor
 Message::~Message() { }
@@ -35,6 +65,24 @@ Message& Message::operator=(const Message& src) {
         m_isHighPriority = src.m_isHighPriority;
         m_payload = src.m_payload;
         m_format = src.m_format;
+        m_origin = src.m_origin;
+        m_traceId = src.m_traceId;
+        m_sequence = src.m_sequence;
+        m_encoded = src.m_encoded;
+    }
+    return *this;
+}
+
+// Move Assignment Operator
+Message& Message::operator=(Message&& src) noexcept {
+    if (this != &src) {
+        m_isHighPriority = src.m_isHighPriority;
+        m_payload = std::move(src.m_payload);
+        m_format = src.m_format;
+        m_origin = src.m_origin;
+        m_traceId = src.m_traceId;
+        m_sequence = src.m_sequence;
+        m_encoded = std::move(src.m_encoded);
     }
     return *this;
 }
@@ -45,6 +93,61 @@ bool Message::isHighPriority() const { return m_isHighPriority; }
 // Get the format of the message
 MessageFormat Message::getFormat() const { return m_format; }
 
+// Get the payload of the message
+const MessagePayload& Message::getPayload() const { return m_payload; }
+
+// Replace the payload, invalidating the cached encoding
+void Message::setPayload(MessagePayload payload) {
+    m_payload = std::move(payload);
+    updateFormat();
+    m_encoded.reset();
+}
+
+// Get the trace id of the message
+uint64_t Message::traceId() const { return m_traceId; }
+
+// Set the trace id, invalidating the cached encoding
+void Message::setTraceId(uint64_t traceId) {
+    m_traceId = traceId;
+    m_encoded.reset();
+}
+
+// Get the sequence number of the message
+uint64_t Message::sequence() const { return m_sequence; }
+
+// Set the sequence number, invalidating the cached encoding
+void Message::setSequence(uint64_t sequence) {
+    m_sequence = sequence;
+    m_encoded.reset();
+}
+
+// Get where the message was last popped from
+uint32_t Message::origin() const { return m_origin; }
+
+// Record where the message was popped from (does not affect the encoding)
+void Message::setOrigin(uint32_t origin) { m_origin = origin; }
+
+// Encode on first use; control block and bytes come from one pool block
+EncodedBuffer Message::encoded() const {
+    if (!m_encoded) {
+        m_encoded = std::allocate_shared<EncodedBytes>(
+            PoolAllocator<EncodedBytes>(encodingPool()), *this);
+        Tracer::instance().record(m_traceId, TraceStage::Encode);
+    }
+    return m_encoded;
+}
+
+// Allocation counters of this thread's encoding pool
+BufferPool::Stats Message::encodingStats() { return encodingPool()->stats(); }
+
+// One pool per encoding thread. Every encoding holds a reference to its pool
+// (through the allocator in its control block), so encodings that outlive the
+// thread, or static destruction, keep their pool alive
+const std::shared_ptr<BufferPool>& Message::encodingPool() {
+    thread_local std::shared_ptr<BufferPool> pool = std::make_shared<BufferPool>(MESSAGE_ENCODING_BLOCKS);
+    return pool;
+}
+
 // Print Message details
 void Message::printMessage() const {
     std::cout << "Priority: " << m_isHighPriority << ", Payload: ";
@@ -77,83 +180,30 @@ void Message::printMessage() const {
     std::cout << std::endl;
 }
 
-// Serialize the Message object to a string
+// Serialize the Message object to a string (reuses the cached encoding)
 std::string Message::serialize() const {
-    //
-    std::ostringstream oss;
-    oss << m_isHighPriority << " " << static_cast<int>(m_format) << " "; // Serialize priority and format
-    
-    // Serialize payload based on its type
-    std::visit([&oss](auto&& payload) {
-        using T = std::decay_t<decltype(payload)>;
-        
-        // Generic message
-        if constexpr (std::is_same_v<T, Generic>) { 
-            oss << payload.value;
-        } 
-        // Wheel message
-        else if constexpr (std::is_same_v<T, WheelMessage>) {
-            oss << payload.velocity << " " << payload.theta << " " << payload.angle_velocity;
-        } 
-        // Arm message
-        else if constexpr (std::is_same_v<T, ArmMessage>) {
-            oss << payload.armXPos << " " << payload.armYPos << " " << payload.armZPos << " "
-                << payload.clawXPos << " " << payload.clawYPos << " " << payload.clawOpen << " "
-                << payload.clawRotation << " " << payload.wristRotation;
-        } 
-        // Science tool message (Don't think we need this anymore)
-        else if constexpr (std::is_same_v<T, ScienceToolMessage>) {
-            oss << payload.moveUpDown << " " << payload.moveLeftRight << " "
-                << payload.xPos << " " << payload.yPos;
-        }
-    }, m_payload);
+    EncodedBuffer bytes = encoded();
+    return std::string(bytes->data(), bytes->size());
+}
 
-    return oss.str();
+// Serialize the Message object into a fixed buffer
+size_t Message::serializeTo(char* out, size_t capacity) const {
+    return TextCodec::encode(*this, out, capacity);
 }
 
 // Deserialize a string to a Message object
 Message Message::deserialize(const std::string& data) {
-    std::istringstream iss(data);
-    bool isHighPriority;
-    int formatInt;
-    iss >> isHighPriority >> formatInt;
-
-    MessageFormat format = static_cast<MessageFormat>(formatInt);
-
-    // Deserialize payload based on format
-    MessagePayload payload;
-    switch (format) {
-        case MESSAGE_FORMAT_WHEEL: {
-            WheelMessage wm;
-            iss >> wm.velocity >> wm.theta >> wm.angle_velocity;
-            payload = wm;
-            break;
-        }
-        case MESSAGE_FORMAT_ARM: {
-            ArmMessage am;
-            iss >> am.armXPos >> am.armYPos >> am.armZPos
-                >> am.clawXPos >> am.clawYPos >> am.clawOpen
-                >> am.clawRotation >> am.wristRotation;
-            payload = am;
-            break;
-        }
-        case MESSAGE_FORMAT_SCIENCE_TOOL: {
-            ScienceToolMessage stm;
-            iss >> stm.moveUpDown >> stm.moveLeftRight >> stm.xPos >> stm.yPos;
-            payload = stm;
-            break;
-        }
-        default: { // Generic or unknown
-            Generic g;
-            iss >> g.value;
-            payload = g;
-            break;
-        }
-    }
+    return deserialize(data.data(), data.size());
+}
 
+// Deserialize a byte range to a Message object, throwing if it is malformed
+Message Message::deserialize(const char* data, size_t size) {
     Message msg;
-    msg.m_isHighPriority = isHighPriority;
-    msg.m_format = format;
-    msg.m_payload = payload;
+    DecodeResult result = TextCodec::decode(std::string_view(data, size), msg);
+    if (!result) {
+        throw std::runtime_error(std::string("Malformed message (")
+            + TextCodec::errorString(result.error) + " at byte "
+            + std::to_string(result.position) + ")");
+    }
     return msg;
 }
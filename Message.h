@@ -4,11 +4,15 @@
 #pragma once
 
 #include "pub_general.h"
+#include "BufferPool.h"
 #include <iostream>
 #include <stdint.h>
 #include <variant>
 #include <vector>
 #include <sstream>
+#include <memory>
+
+#define MESSAGE_ENCODING_BLOCKS 64 // Pool blocks for cached encodings, per encoding thread
 
 // Commented out section below allows multiple message types (structs) while
 // letting Message have the same format
@@ -19,6 +23,41 @@
 using MessagePayload
     = std::variant<Generic, WheelMessage, ArmMessage, ScienceToolMessage>;
 
+class Message;
+
+// Serialized bytes of a Message. Built once, never modified, and shared by all
+// copies of the Message it was built from
+class EncodedBytes {
+public:
+    explicit EncodedBytes(const Message& msg);
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    // Upper bound on what std::allocate_shared puts next to the object in
+    // the same allocation: a vtable pointer, the two reference counts and a
+    // copy of the allocator
+    struct ControlBlockBound {
+        void* vtable;
+        long counts[2];
+        PoolAllocator<EncodedBytes> allocator;
+    };
+
+private:
+    // Sized so the shared_ptr control block and this object fit one pool
+    // block (checked by a static_assert in Message.cpp)
+    static constexpr size_t INLINE_SIZE = BUFFER_POOL_BLOCK_SIZE - sizeof(ControlBlockBound)
+                                        - sizeof(const char*) - sizeof(size_t)
+                                        - sizeof(std::unique_ptr<char[]>);
+
+    const char* m_data;
+    size_t m_size;
+    std::unique_ptr<char[]> m_heap;   // Only used if the encoding outgrows m_inline
+    char m_inline[INLINE_SIZE];
+};
+
+using EncodedBuffer = std::shared_ptr<const EncodedBytes>;
+
 class Message {
 public:
     /** Constructor for message
@@ -34,8 +73,10 @@ public:
     Message(int prty, MessagePayload payload);
     Message();
     Message(Message const& src);
+    Message(Message&& src) noexcept;
     ~Message();
     Message& operator=(const Message& src);
+    Message& operator=(Message&& src) noexcept;
 
     /** Returns if a message has priority
      *
@@ -59,6 +100,127 @@ public:
 
     MessageFormat getFormat() const;
 
+    /** Returns the payload carried by the message
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (const MessagePayload&) the struct held by the message
+     */
+    const MessagePayload& getPayload() const;
+
+    /** Replaces the payload (and format) of the message. Drops the cached
+     * encoding
+     *
+     * @param
+     * payload (MessagePayload): the new struct for the message
+     *
+     * @return
+     * none
+     */
+    void setPayload(MessagePayload payload);
+
+    /** Returns the trace id of the message (0 if it is not traced)
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (uint64_t) the trace id assigned by Tracer
+     */
+    uint64_t traceId() const;
+
+    /** Sets the trace id of the message. Drops the cached encoding, since
+     * traced messages carry their id on the wire
+     *
+     * @param
+     * traceId (uint64_t): the trace id (0 = not traced)
+     *
+     * @return
+     * none
+     */
+    void setTraceId(uint64_t traceId);
+
+    /** Returns the delivery sequence number of the message (0 if none)
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (uint64_t) the position the server sent the message in on its channel
+     */
+    uint64_t sequence() const;
+
+    /** Sets the delivery sequence number. Drops the cached encoding, since
+     * sequenced messages carry their number on the wire
+     *
+     * @param
+     * sequence (uint64_t): the sequence number (0 = none)
+     *
+     * @return
+     * none
+     */
+    void setSequence(uint64_t sequence);
+
+    /** Returns where a queue took the message from, for putting it back
+     * there on requeue (0 if not recorded). Not part of the encoding
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (uint32_t) the queue's origin tag (ShardedMessageQueue: shard index + 1)
+     */
+    uint32_t origin() const;
+
+    /** Records where a queue took the message from (see origin())
+     *
+     * @param
+     * origin (uint32_t): the queue's origin tag (0 = none)
+     *
+     * @return
+     * none
+     */
+    void setOrigin(uint32_t origin);
+
+    /** Returns the serialized form of the message, encoding it on first use.
+     * Copies of a Message made after this call share the same buffer, so a
+     * message is encoded once no matter how many times it is sent or logged.
+     * Like the rest of Message, not safe to call concurrently on one object
+     * (copies are independent)
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  EncodedBuffer - Immutable, reference-counted serialized bytes
+     */
+    EncodedBuffer encoded() const;
+
+    /** Returns the allocation counters of the pool backing encoded() on the
+     * calling thread
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  BufferPool::Stats - The counters of this thread's encoding pool
+     */
+    static BufferPool::Stats encodingStats();
+
+    /** Returns the pool backing encoded() on the calling thread. Each thread
+     * that encodes gets its own pool, so threads do not contend on one
+     * allocator; a pool lives until the last encoding taken from it is gone
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  const std::shared_ptr<BufferPool>& - This thread's encoding pool
+     */
+    static const std::shared_ptr<BufferPool>& encodingPool();
+
     /** Serializes the Message object to a string
      *
      * @return
@@ -66,20 +228,52 @@ public:
      */
     std::string serialize() const;
 
+    /** Serializes the Message object into a caller-provided buffer without
+     * allocating. Produces the same bytes as serialize()
+     *
+     * @param
+     *  out: char* - Destination buffer
+     *  capacity: size_t - Size of the destination buffer
+     *
+     * @return
+     *  size_t - Length of the serialized message. If larger than capacity the
+     *           output was truncated and a bigger buffer is needed
+     */
+    size_t serializeTo(char* out, size_t capacity) const;
+
     /** Deserializes a string to a Message object
      *
      * @param
      *  data: const std::string& - The serialized message string
      *
      * @return
-     *  Message - The deserialized Message object
+     *  Message - The deserialized Message object. Throws std::runtime_error
+     *            if the message is malformed (see TextCodec::decode)
      */
     static Message deserialize(const std::string& data);
 
+    /** Deserializes a byte range to a Message object without copying it
+     *
+     * @param
+     *  data: const char* - The serialized message bytes
+     *  size: size_t - Number of bytes
+     *
+     * @return
+     *  Message - The deserialized Message object. Throws std::runtime_error
+     *            if the message is malformed (see TextCodec::decode)
+     */
+    static Message deserialize(const char* data, size_t size);
+
 private:
+    void updateFormat();
+
     bool m_isHighPriority;    // Priority of message
     MessagePayload m_payload; // One of the struct messages
     MessageFormat m_format;
+    uint32_t m_origin;        // Set by the queue it was last popped from (0 = none)
+    uint64_t m_traceId;       // Tracer id (0 = not traced)
+    uint64_t m_sequence;      // Channel send order in dual-stream mode (0 = none)
+    mutable EncodedBuffer m_encoded; // Cached serialized form (null until first encoded())
 };
 
 #endif
\ No newline at end of file
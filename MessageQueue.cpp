@@ -1,4 +1,5 @@
 #include "MessageQueue.h"
+#include "Tracer.h"
 
 MessageQueue::MessageQueue() { }
 
@@ -11,34 +12,48 @@ MessageQueue::~MessageQueue() { }
 /* 
  * Add message into correct queue depending on priority
  */
-void MessageQueue::push(const Message message) {
-
-    // Check for Queue limit
-    if (this->isQueueLimit()) {
-        std::cout << "Queue limit reached. push discarded" << std::endl;
-        return;
-    }
+bool MessageQueue::push(const Message message) {
 
     // Thread acquires lock
     std::unique_lock<std::mutex> lock(m_mutex);
 
-    if (message.isHighPriority()) {
-        m_priorityQueue.push(message);
-    } else {
-        m_regularQueue.push(message);
+    // Durable regular messages go to disk once memory is full, and keep going
+    // there until the disk backlog is drained so FIFO order is kept
+    if (m_spill && !message.isHighPriority() && m_spill->accepts(message)
+        && (this->isQueueLimit() || !m_spill->empty())) {
+        Message spilled = message;
+        Tracer::instance().onPush(spilled);
+        if (!m_spill->append(spilled)) {
+            lock.unlock();
+            std::cerr << "Spill file full. push discarded" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Check for Queue limit
+    if (this->isQueueLimit()) {
+        lock.unlock();
+        std::cerr << "Queue limit reached. push discarded" << std::endl;
+        return false;
     }
 
+    Lane& lane = message.isHighPriority() ? m_priorityQueue : m_regularQueue;
+    lane.push_back(message);
+    Tracer::instance().onPush(lane.back());
+
     // If there is a thread waiting to pop an element with nothing in the
     // queues, this sends a signal to let that thread know that something has
     // been added to the queue and it is now safe to pop
-    m_cond_push.notify_one();
+    notifyPushed();
+
+    return true;
 }
 
 /* 
  * Remove message from correct queue depending on priority
  */
 Message MessageQueue::pop() {
-    Message returnMessage;
 
     // Thread acquires lock
     std::unique_lock<std::mutex> lock(m_mutex);
@@ -49,18 +64,130 @@ Message MessageQueue::pop() {
         return !m_priorityQueue.empty() || !m_regularQueue.empty();
     });
 
+    return popLocked();
+}
+
+/* 
+ * Remove message from correct queue, giving up after timeout
+ */
+bool MessageQueue::tryPop(Message& message, std::chrono::milliseconds timeout, PopFilter filter) {
+
+    // Thread acquires lock
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Waits for a signal from push() method, at most timeout
+    bool filtered = (filter != PopFilter::Any);
+    m_filteredWaiters += filtered;
+    bool ready = m_cond_push.wait_for(lock, timeout, [this, filter]() { return hasLocked(filter); });
+    m_filteredWaiters -= filtered;
+
+    if (!ready)
+        return false;
+
+    message = popLocked(filter);
+    return true;
+}
+
+/* 
+ * Remove a front message only if the caller accepts it, priority queue first
+ */
+bool MessageQueue::tryPopIf(Message& message, PopFilter filter,
+                            const std::function<bool(const Message&)>& accept) {
+
+    // Thread acquires lock
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    PopFilter lanes[2] = { PopFilter::PriorityOnly, PopFilter::RegularOnly };
+    for (PopFilter lane : lanes) {
+        Lane& queue = (lane == PopFilter::PriorityOnly) ? m_priorityQueue : m_regularQueue;
+        if (filter != PopFilter::Any && filter != lane)
+            continue;
+        if (!queue.empty() && accept(queue.front())) {
+            message = popLocked(lane);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* 
+ * Put an undelivered message back at the front of its queue
+ */
+void MessageQueue::requeue(const Message message) {
+
+    // Thread acquires lock
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    Lane& lane = message.isHighPriority() ? m_priorityQueue : m_regularQueue;
+    if (!lane.push_front(message)) {
+        lock.unlock();
+        std::cerr << "Queue reserve exhausted. requeue discarded" << std::endl;
+        return;
+    }
+
+    notifyPushed();
+}
+
+/* 
+ * A waiter restricted to one lane may not be able to take the new message,
+ * so wake everyone while there are such waiters (lock held by caller)
+ */
+void MessageQueue::notifyPushed() {
+    if (m_filteredWaiters > 0)
+        m_cond_push.notify_all();
+    else
+        m_cond_push.notify_one();
+}
+
+/* 
+ * Returns if a lane allowed by filter has a message (lock held by caller)
+ */
+bool MessageQueue::hasLocked(PopFilter filter) {
+    return (filter != PopFilter::RegularOnly && !m_priorityQueue.empty())
+        || (filter != PopFilter::PriorityOnly && !m_regularQueue.empty());
+}
+
+/* 
+ * Remove the front message, priority queue first (lock held by caller)
+ */
+Message MessageQueue::popLocked(PopFilter filter) {
+    Message returnMessage;
+
     // get front() and pop
-    if (!m_priorityQueue.empty()) {
-        returnMessage = m_priorityQueue.front();
-        m_priorityQueue.pop();
-    } else if (!m_regularQueue.empty()) {
-        returnMessage = m_regularQueue.front();
-        m_regularQueue.pop();
+    if (filter != PopFilter::RegularOnly && !m_priorityQueue.empty()) {
+        returnMessage = m_priorityQueue.pop_front();
+    } else if (filter != PopFilter::PriorityOnly && !m_regularQueue.empty()) {
+        returnMessage = m_regularQueue.pop_front();
     }
 
+    Tracer::instance().record(returnMessage.traceId(), TraceStage::Pop);
+    refillLocked();
     return returnMessage;
 }
 
+/* 
+ * Move spilled messages back into memory, oldest first (lock held by caller)
+ */
+void MessageQueue::refillLocked() {
+    Message message;
+    while (m_spill && !m_spill->empty() && !this->isQueueLimit() && m_spill->pop(message))
+        m_regularQueue.push_back(message);
+}
+
+/* 
+ * Open the spill file and pull in anything left from a previous run
+ */
+void MessageQueue::enableSpill(const SpillConfig& config) {
+    auto spill = std::make_unique<SpillLog>(config);
+
+    // Thread acquires lock
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_spill = std::move(spill);
+    refillLocked();
+    m_cond_push.notify_all();
+}
+
 //----------------//
 /* DATA RETRIEVAL */
 //----------------//
@@ -162,7 +289,7 @@ size_t MessageQueue::size() {
     // Thread acquires lock
     std::unique_lock<std::mutex> lock(m_mutex);
 
-    return m_priorityQueue.size() + m_regularQueue.size();
+    return m_priorityQueue.size() + m_regularQueue.size() + (m_spill ? m_spill->size() : 0);
 }
 
 /* 
@@ -184,7 +311,18 @@ size_t MessageQueue::sizeRegular() {
     // Thread acquires lock
     std::unique_lock<std::mutex> lock(m_mutex);
 
-    return m_regularQueue.size();
+    return m_regularQueue.size() + (m_spill ? m_spill->size() : 0);
+}
+
+/* 
+ * Returns how many regular messages are waiting on disk
+ */
+size_t MessageQueue::sizeSpilled() {
+
+    // Thread acquires lock
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    return m_spill ? m_spill->size() : 0;
 }
 
 /* 
@@ -204,7 +342,7 @@ bool MessageQueue::empty() {
 bool MessageQueue::isQueueLimit() {
 
     // Compare size of this MessageQueue Object to the QUEUE_LIMIT
-    if (this->size() >= QUEUE_LIMIT)
+    if (m_priorityQueue.size() + m_regularQueue.size() >= QUEUE_LIMIT)
         return true;
 
     else
@@ -2,23 +2,28 @@
 #define QUEUE_H
 
 #define QUEUE_LIMIT 100 // The maximum size of the queue
+#define QUEUE_REQUEUE_RESERVE 16 // Extra slots per queue for messages put back by requeue()
 
+#include "IMessageQueue.h"
 #include "Message.h"
+#include "RingBuffer.h"
+#include "SpillLog.h"
+#include <chrono>
 #include <condition_variable>
 #include <iostream>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread> // For testing purposes only
 
 #pragma once
 
-class MessageQueue {
+class MessageQueue : public IMessageQueue {
 
 public:
     // Constructor
     MessageQueue();
     // Destructor
-    ~MessageQueue();
+    ~MessageQueue() override;
 
     /** Add message into correct queue depending on priority
      *
@@ -26,9 +31,10 @@ public:
      * message (Message): the Message object being added to the queue
      *
      * @return
-     * none
+     * (bool) if the message was queued (True) or discarded because the queue
+     * is at its limit (False)
      */
-    void push(const Message message);
+    bool push(const Message message) override;
 
     /** Remove message into correct queue depending on priority
      *
@@ -38,7 +44,63 @@ public:
      * @return
      * (Message) the Message object in the front of the queue
      */
-    Message pop();
+    Message pop() override;
+
+    /** Remove message from correct queue, waiting at most `timeout` for one
+     *
+     * @param
+     * message (Message&): receives the popped Message object
+     * timeout (std::chrono::milliseconds): how long to wait for a message
+     * filter (PopFilter): restrict the pop to one queue (default either)
+     *
+     * @return
+     * (bool) if a message was popped (True) or the wait timed out (False)
+     */
+    bool tryPop(Message& message, std::chrono::milliseconds timeout,
+                PopFilter filter = PopFilter::Any) override;
+
+    /** Remove the front message of a queue without waiting, if `accept`
+     * returns true for it (see IMessageQueue::tryPopIf)
+     *
+     * @param
+     * message (Message&): receives the popped Message object
+     * filter (PopFilter): restrict the pop to one queue
+     * accept (const std::function<bool(const Message&)>&): decides if a front message is taken
+     *
+     * @return
+     * (bool) if a message was popped (True) or none was accepted (False)
+     */
+    bool tryPopIf(Message& message, PopFilter filter,
+                  const std::function<bool(const Message&)>& accept) override;
+
+    /** Put a popped message back at the front of its queue so that it is the
+     * next one popped. Used when a message could not be delivered. Ignores the
+     * queue limit since the message already held a slot.
+     *
+     * @param
+     * message (Message): the Message object being returned to the queue
+     *
+     * @return
+     * none
+     */
+    void requeue(const Message message) override;
+
+    /** Turn on disk spill-over for the regular queue. Once the queue is at its
+     * limit, regular messages of the configured formats are appended to a
+     * memory-mapped segment file instead of being discarded, and are moved
+     * back into memory in FIFO order as the queue drains. Only messages that do
+     * not fit in memory are on disk; those left in the file by a previous run
+     * are resumed. front()/back() only see messages in memory
+     *
+     * @param
+     * config (SpillConfig): the segment file, its size and flush policy
+     *
+     * @return
+     * none
+     *
+     * Throws std::runtime_error if the file cannot be opened.
+     */
+    void enableSpill(const SpillConfig& config);
 
     //----------------//
     /** DATA RETRIEVAL */
@@ -92,7 +154,7 @@ public:
      * @return
      * (size_t) the number of elements in the queue
      */
-    size_t size();
+    size_t size() override;
 
     /** Returns how many elements are in the priority queue
      *
@@ -114,6 +176,16 @@ public:
      */
     size_t sizeRegular();
 
+    /** Returns how many regular messages are waiting on disk
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (size_t) the number of spilled messages (0 if spill is off)
+     */
+    size_t sizeSpilled();
+
     /** Returns if the queue is empty (True) or not (False)
      *
      * @param
@@ -122,18 +194,29 @@ public:
      * @return
      * (bool) if the queue is empty (True) or not (False)
      */
-    bool empty();
+    bool empty() override;
 
 private:
-    std::queue<Message> m_priorityQueue; // The priority queue
-    std::queue<Message> m_regularQueue;  // The regular queue
+    // Fixed storage so pushing and popping never allocate
+    using Lane = RingBuffer<Message, QUEUE_LIMIT + QUEUE_REQUEUE_RESERVE>;
+
+    Lane m_priorityQueue; // The priority queue
+    Lane m_regularQueue;  // The regular queue
+    std::unique_ptr<SpillLog> m_spill; // Overflow of the regular queue (null if off)
 
     std::mutex m_mutex; // Lock to prevent accesses by multiples threads
     std::condition_variable
         m_cond_push; // Used to signal when a push has been done on a queue (For
                      // threading purposes)
+    size_t m_filteredWaiters = 0; // Waiters that only take one lane; pushes wake all of them
+
+    // Wake a waiter that can take the new message
+    void notifyPushed();
 
-    /** Returns if queue has reached a maximum capacity
+    // If the lanes allowed by filter hold a message. Caller holds the lock
+    bool hasLocked(PopFilter filter);
+
+    /** Returns if queue has reached a maximum capacity. Caller holds the lock
      *
      * @param
      * none
@@ -142,6 +225,28 @@ private:
      * (bool) if the queue is at its limit (True) or not (False)
      */
     bool isQueueLimit();
+
+    /** Move spilled messages back into the regular queue while there is room.
+     * Caller holds the lock
+     *
+     * @param
+     * none
+     *
+     * @return
+     * none
+     */
+    void refillLocked();
+
+    /** Remove the front message, priority queue first. Caller holds the lock
+     * and has checked that a queue allowed by filter is non-empty
+     *
+     * @param
+     * filter (PopFilter): the queues that may be popped
+     *
+     * @return
+     * (Message) the Message object in the front of the queue
+     */
+    Message popLocked(PopFilter filter = PopFilter::Any);
 };
 
 #endif
\ No newline at end of file
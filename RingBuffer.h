@@ -0,0 +1,78 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <array>
+#include <stddef.h>
+#include <utility>
+
+#pragma once
+
+// Fixed-capacity double-ended FIFO stored inline, so pushing and popping never
+// allocate. Not thread safe; callers provide their own locking.
+template <typename T, size_t N>
+class RingBuffer {
+public:
+    /** Adds an element at the back
+     *
+     * @param
+     * value (T): the element to add
+     *
+     * @return
+     * (bool) if the element was added (True) or the buffer is full (False)
+     */
+    bool push_back(T value) {
+        if (full())
+            return false;
+        m_items[(m_head + m_size) % N] = std::move(value);
+        ++m_size;
+        return true;
+    }
+
+    /** Adds an element at the front
+     *
+     * @param
+     * value (T): the element to add
+     *
+     * @return
+     * (bool) if the element was added (True) or the buffer is full (False)
+     */
+    bool push_front(T value) {
+        if (full())
+            return false;
+        m_head = (m_head + N - 1) % N;
+        m_items[m_head] = std::move(value);
+        ++m_size;
+        return true;
+    }
+
+    /** Removes and returns the front element. The buffer must not be empty
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (T) the element that was at the front
+     */
+    T pop_front() {
+        T value = std::move(m_items[m_head]);
+        m_head = (m_head + 1) % N;
+        --m_size;
+        return value;
+    }
+
+    // Element access; the buffer must not be empty
+    T& front() { return m_items[m_head]; }
+    T& back() { return m_items[(m_head + m_size - 1) % N]; }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    bool full() const { return m_size == N; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    std::array<T, N> m_items;  // Storage, constructed once
+    size_t m_head = 0;         // Index of the front element
+    size_t m_size = 0;         // Number of stored elements
+};
+
+#endif
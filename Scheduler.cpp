@@ -0,0 +1,311 @@
+#include "Scheduler.h"
+#include <algorithm>
+#include <stdexcept>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit (bits must not be 0)
+static uint32_t lowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(bits));
+#endif
+}
+
+// Constructor
+Scheduler::Scheduler(IMessageQueue& queue, std::chrono::microseconds tick) :
+    m_queue(queue), m_tick(tick), m_start(Clock::now())
+{
+    if (tick.count() <= 0)
+        throw std::runtime_error("Scheduler tick must be positive");
+
+    m_nodes.reserve(SCHEDULER_POOL_SIZE);
+    m_released.reserve(SLOTS);
+    m_thread = std::thread(&Scheduler::run, this);
+}
+
+// Destructor
+Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+}
+
+// One-shot release at a time
+TimerId Scheduler::schedule(const Message& message, Clock::time_point at) {
+    return add(message, at, 0);
+}
+
+// One-shot release after a delay
+TimerId Scheduler::schedule(const Message& message, Clock::duration delay) {
+    return add(message, Clock::now() + delay, 0);
+}
+
+// Repeated release, at least one tick apart
+TimerId Scheduler::schedulePeriodic(const Message& message, Clock::duration interval,
+                                    Clock::duration firstDelay) {
+    if (interval <= Clock::duration::zero())
+        throw std::runtime_error("Scheduler interval must be positive");
+
+    uint64_t period = static_cast<uint64_t>((interval + m_tick - Clock::duration(1)) / m_tick);
+    return add(message, Clock::now() + firstDelay, std::max<uint64_t>(period, 1));
+}
+
+/*
+ * Take a node from the pool and put it in the wheel. The id packs the node's
+ * generation with its index (+1 so that 0 is never a valid id). The stored
+ * copy has no trace id or sequence number; pushes stamp their own copy, so
+ * every release, periodic ones included, is traced and numbered afresh
+ */
+TimerId Scheduler::add(const Message& message, Clock::time_point at, uint64_t period) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // An empty wheel is not advanced while idle; catch it up first
+    if (m_count == 0)
+        m_current = std::max(m_current, tickAt(Clock::now()));
+
+    uint32_t index = allocate();
+    Node& node = m_nodes[index];
+    node.message = message;
+    node.message.setTraceId(0);
+    node.message.setSequence(0);
+    node.due = tickAtOrAfter(at);
+    node.period = period;
+    node.active = true;
+    insert(index);
+    ++m_count;
+
+    // Wake the timer thread if it is sleeping past the new release
+    if (node.due < m_wakeTick)
+        m_cond.notify_one();
+
+    return (static_cast<uint64_t>(node.generation) << 32) | (index + 1);
+}
+
+// Remove a pending node, if the id still refers to it
+bool Scheduler::cancel(TimerId id) {
+    uint32_t index = static_cast<uint32_t>(id) - 1;
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (index >= m_nodes.size() || !m_nodes[index].active || m_nodes[index].generation != generation)
+        return false;
+
+    unlink(index);
+    release(index);
+    return true;
+}
+
+// Number of pending nodes
+size_t Scheduler::pending() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
+
+// Ticks elapsed at a time (0 before the start)
+uint64_t Scheduler::tickAt(Clock::time_point time) const {
+    if (time <= m_start)
+        return 0;
+    return static_cast<uint64_t>((time - m_start) / m_tick);
+}
+
+// First tick that is not before a time, so nothing is released early
+uint64_t Scheduler::tickAtOrAfter(Clock::time_point time) const {
+    if (time <= m_start)
+        return 0;
+    return static_cast<uint64_t>((time - m_start + m_tick - Clock::duration(1)) / m_tick);
+}
+
+/*
+ * Put a node in the finest level whose range covers its due tick. Slots are
+ * picked by the due tick's bits for that level, so a slot is moved down
+ * exactly when the levels below it wrap around to it
+ */
+void Scheduler::insert(uint32_t index) {
+    Node& node = m_nodes[index];
+    uint64_t due = std::max(node.due, m_current);
+    uint64_t delta = due - m_current;
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1))))
+        ++level;
+
+    // Past the last level's range: park it at the far end, it is placed
+    // again by its real due tick when that slot cascades
+    if (delta >= (1ull << (SLOT_BITS * LEVELS)))
+        due = m_current + (1ull << (SLOT_BITS * LEVELS)) - 1;
+
+    uint32_t slotIndex = level * SLOTS + static_cast<uint32_t>((due >> (SLOT_BITS * level)) & (SLOTS - 1));
+    Slot& slot = m_slots[slotIndex];
+
+    node.slot = static_cast<uint16_t>(slotIndex);
+    node.next = NONE;
+    node.prev = slot.tail;
+    if (slot.tail != NONE)
+        m_nodes[slot.tail].next = index;
+    else
+        slot.head = index;
+    slot.tail = index;
+
+    m_occupied[slotIndex / 64] |= 1ull << (slotIndex % 64);
+}
+
+// Take a node out of its slot
+void Scheduler::unlink(uint32_t index) {
+    Node& node = m_nodes[index];
+    Slot& slot = m_slots[node.slot];
+
+    if (node.prev != NONE)
+        m_nodes[node.prev].next = node.next;
+    else
+        slot.head = node.next;
+    if (node.next != NONE)
+        m_nodes[node.next].prev = node.prev;
+    else
+        slot.tail = node.prev;
+
+    if (slot.head == NONE)
+        m_occupied[node.slot / 64] &= ~(1ull << (node.slot % 64));
+}
+
+// Move the current slot of a level down into the finer levels
+void Scheduler::cascade(int level) {
+    uint32_t slotIndex = level * SLOTS + static_cast<uint32_t>((m_current >> (SLOT_BITS * level)) & (SLOTS - 1));
+    Slot& slot = m_slots[slotIndex];
+    uint32_t index = slot.head;
+
+    slot.head = slot.tail = NONE;
+    m_occupied[slotIndex / 64] &= ~(1ull << (slotIndex % 64));
+
+    while (index != NONE) {
+        uint32_t next = m_nodes[index].next;
+        insert(index);
+        index = next;
+    }
+}
+
+/*
+ * Cascade the coarser levels that wrap at this tick (finest first, as a
+ * coarser cascade can only fill finer slots still ahead), then release
+ * everything in the finest level's slot
+ */
+void Scheduler::advance() {
+    uint64_t tick = m_current;
+    for (int level = 1; level < LEVELS; ++level) {
+        if ((tick & ((1ull << (SLOT_BITS * level)) - 1)) != 0)
+            break;
+        cascade(level);
+    }
+
+    uint32_t slotIndex = static_cast<uint32_t>(tick & (SLOTS - 1));
+    Slot& slot = m_slots[slotIndex];
+    uint32_t index = slot.head;
+
+    slot.head = slot.tail = NONE;
+    m_occupied[slotIndex / 64] &= ~(1ull << (slotIndex % 64));
+    m_current = tick + 1;
+
+    while (index != NONE) {
+        Node& node = m_nodes[index];
+        uint32_t next = node.next;
+        m_released.push_back(node.message);
+
+        if (node.period != 0) {
+            // Stay on the original schedule; releases missed while the
+            // thread was held up are skipped rather than sent in a burst
+            node.due += node.period;
+            if (node.due <= tick)
+                node.due += ((tick - node.due) / node.period + 1) * node.period;
+            insert(index);
+        } else {
+            release(index);
+        }
+        index = next;
+    }
+}
+
+/*
+ * The next occupied slot of the finest level, or else the next wrap of the
+ * finest level (the coarser levels can only have work from there). The wrap
+ * may be the current tick itself, whose cascade has not run yet
+ */
+uint64_t Scheduler::nextTick() const {
+    if (m_count == 0)
+        return UINT64_MAX;
+
+    uint32_t from = static_cast<uint32_t>(m_current & (SLOTS - 1));
+    uint64_t base = m_current - from;
+
+    for (uint32_t word = from / 64; word < SLOTS / 64; ++word) {
+        uint64_t bits = m_occupied[word];
+        if (word == from / 64)
+            bits &= ~0ull << (from % 64);
+        if (bits != 0)
+            return base + word * 64 + lowestBit(bits);
+    }
+    return from == 0 ? m_current : base + SLOTS;
+}
+
+// Take a node from the free list, growing the pool if it is empty
+uint32_t Scheduler::allocate() {
+    if (m_free != NONE) {
+        uint32_t index = m_free;
+        m_free = m_nodes[index].next;
+        return index;
+    }
+    m_nodes.emplace_back();
+    return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+// Return a node to the free list, dropping its message
+void Scheduler::release(uint32_t index) {
+    Node& node = m_nodes[index];
+    node.active = false;
+    node.generation++;
+    node.message = Message();
+    node.next = m_free;
+    m_free = index;
+    --m_count;
+}
+
+/*
+ * Process every tick up to now, push what was released outside the lock,
+ * then sleep until the next tick that may have work
+ */
+void Scheduler::run() {
+    std::vector<Message> batch;
+    batch.reserve(SLOTS);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping) {
+        uint64_t now = tickAt(Clock::now());
+        while (m_count > 0 && m_current <= now)
+            advance();
+
+        if (!m_released.empty()) {
+            batch.swap(m_released);
+            lock.unlock();
+            for (const Message& message : batch) {
+                if (!m_queue.push(message))
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            batch.clear();
+            lock.lock();
+            continue;
+        }
+
+        m_wakeTick = nextTick();
+        if (m_wakeTick == UINT64_MAX)
+            m_cond.wait(lock);
+        else
+            m_cond.wait_until(lock, m_start + m_wakeTick * m_tick);
+        m_wakeTick = UINT64_MAX;
+    }
+}
@@ -0,0 +1,191 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#define SCHEDULER_TICK_US 100 // Default wheel resolution in microseconds
+#define SCHEDULER_POOL_SIZE 4096 // Timer nodes allocated up front (the pool grows past this if needed)
+
+#include "IMessageQueue.h"
+#include "Message.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#pragma once
+
+// Handle for a scheduled message, used to cancel it (0 is never a valid id)
+using TimerId = uint64_t;
+
+// Releases messages into a queue at a given time, or repeatedly at an interval.
+//
+// Pending messages live in a hierarchical timer wheel: four levels of 256
+// slots, each level 256 times coarser than the one below. Scheduling and
+// cancelling are O(1); a message is moved down a level at most three times
+// before it fires. A single timer thread sleeps until the next occupied
+// slot of the finest level and pushes everything due at that tick, so
+// thousands of pending messages cost one thread and no per-message wakeups.
+//
+// Messages are never released early. With the default 100us tick they are
+// released within about one tick of their time, plus the OS wakeup latency.
+// Periodic messages are rescheduled from their previous due time, so they do
+// not drift. Each release is pushed as a new message: any trace id or
+// sequence number the scheduled message carried is cleared, so the tracer and
+// the server stamp every release separately. A release that finds the queue
+// full is discarded like any other push (see dropped()).
+//
+// Example Usage:
+//   Scheduler scheduler(queue);
+//   scheduler.schedule(Message(0, ArmMessage{...}), std::chrono::milliseconds(200));
+//   scheduler.schedule(Message(0, ArmMessage{...}), std::chrono::milliseconds(500));
+//   TimerId keepAlive = scheduler.schedulePeriodic(Message(0, WheelMessage{0, 0, 0}),
+//                                                  std::chrono::milliseconds(100));
+//   ...
+//   scheduler.cancel(keepAlive);
+class Scheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** Constructor for Scheduler. Starts the timer thread
+     *
+     * @param
+     *  queue: IMessageQueue& - Where released messages are pushed; must outlive the scheduler
+     *  tick: std::chrono::microseconds - Resolution of the wheel (default SCHEDULER_TICK_US)
+     *
+     * Throws std::runtime_error if tick is not positive.
+     */
+    explicit Scheduler(IMessageQueue& queue,
+                       std::chrono::microseconds tick = std::chrono::microseconds(SCHEDULER_TICK_US));
+
+    // Stops the timer thread. Messages still pending are not released
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /** Schedules a message to be pushed at a point in time
+     *
+     * @param
+     *  message: const Message& - The message to release
+     *  at: Clock::time_point - When to push it (a time in the past releases it on the next tick)
+     *
+     * @return
+     *  TimerId - Handle for cancel()
+     */
+    TimerId schedule(const Message& message, Clock::time_point at);
+
+    /** Schedules a message to be pushed after a delay
+     *
+     * @param
+     *  message: const Message& - The message to release
+     *  delay: Clock::duration - How long from now to push it
+     *
+     * @return
+     *  TimerId - Handle for cancel()
+     */
+    TimerId schedule(const Message& message, Clock::duration delay);
+
+    /** Schedules a message to be pushed repeatedly until cancelled
+     *
+     * @param
+     *  message: const Message& - The message to release each time
+     *  interval: Clock::duration - Time between releases (rounded up to one tick)
+     *  firstDelay: Clock::duration - Time until the first release (default now)
+     *
+     * @return
+     *  TimerId - Handle for cancel()
+     *
+     * Throws std::runtime_error if interval is not positive.
+     */
+    TimerId schedulePeriodic(const Message& message, Clock::duration interval,
+                             Clock::duration firstDelay = Clock::duration::zero());
+
+    /** Cancels a pending message, or stops a periodic one
+     *
+     * @param
+     *  id: TimerId - The handle returned when it was scheduled
+     *
+     * @return
+     *  bool - True if it was pending, False if it already fired or was cancelled
+     */
+    bool cancel(TimerId id);
+
+    /** Returns how many messages are waiting to be released
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  size_t - Pending one-shot and periodic messages
+     */
+    size_t pending();
+
+    // Releases the queue refused because it was full
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 8;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint32_t NONE = UINT32_MAX;   // End of a list
+
+    // A pending message, linked into one wheel slot (or the free list)
+    struct Node {
+        Message message;
+        uint64_t due = 0;          // Tick to release at
+        uint64_t period = 0;       // Ticks between releases (0 = once)
+        uint32_t next = NONE;
+        uint32_t prev = NONE;
+        uint32_t generation = 0;   // Bumped on reuse so stale ids cannot cancel a new timer
+        uint16_t slot = 0;         // Slot index across all levels (level * SLOTS + index)
+        bool active = false;
+    };
+
+    // Doubly linked list of nodes, in insertion order
+    struct Slot {
+        uint32_t head = NONE;
+        uint32_t tail = NONE;
+    };
+
+    TimerId add(const Message& message, Clock::time_point at, uint64_t period);
+
+    // Ticks since the scheduler started, rounding down or up
+    uint64_t tickAt(Clock::time_point time) const;
+    uint64_t tickAtOrAfter(Clock::time_point time) const;
+
+    // Wheel operations (m_mutex held)
+    void insert(uint32_t index);
+    void unlink(uint32_t index);
+    void cascade(int level);
+    void advance();                 // Process m_current and move to the next tick
+    uint64_t nextTick() const;      // Earliest tick that may have work
+    uint32_t allocate();
+    void release(uint32_t index);
+
+    // Timer thread body
+    void run();
+
+    IMessageQueue& m_queue;
+    const Clock::duration m_tick;
+    const Clock::time_point m_start;
+
+    std::mutex m_mutex;              // Guards everything below
+    std::condition_variable m_cond;
+    std::vector<Node> m_nodes;       // Node pool; ids index into it
+    uint32_t m_free = NONE;          // Head of the free list
+    Slot m_slots[LEVELS * SLOTS];
+    uint64_t m_occupied[LEVELS * SLOTS / 64] = {};  // Bit per non-empty slot
+    uint64_t m_current = 0;          // Next tick to process
+    uint64_t m_wakeTick = UINT64_MAX; // Tick the timer thread is sleeping until
+    size_t m_count = 0;              // Pending nodes
+    std::vector<Message> m_released; // Messages due at the ticks being processed
+    bool m_stopping = false;
+
+    std::atomic<uint64_t> m_dropped { 0 };
+    std::thread m_thread;
+};
+
+#endif
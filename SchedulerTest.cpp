@@ -0,0 +1,206 @@
+// Checks the Scheduler's timer wheel with a small tick: nothing is released
+// early, timers that cross level 1 and level 2 boundaries fire in due order,
+// a stale id cannot cancel the timer that reused its node, and periodic
+// releases keep to their schedule.
+// Run through ctest, or directly: ./bin/SchedulerTest
+
+#include "Scheduler.h"
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using Clock = Scheduler::Clock;
+
+// 256 ticks per level: level 1 starts at 1.28ms, level 2 at ~328ms
+static const std::chrono::microseconds TICK(5);
+
+// Timers are due at least this far ahead, so none is already past due when
+// it is scheduled (those go out on the next tick, in scheduling order)
+static const std::chrono::milliseconds LEAD(5);
+
+static int failures = 0;
+
+// Report a failed check
+static void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAIL: " << what << "\n";
+        ++failures;
+    }
+}
+
+// A released message and when it was pushed
+struct Release {
+    Clock::time_point time;
+    int tag;
+};
+
+// Queue that records each push instead of holding messages
+class Recorder : public IMessageQueue {
+public:
+    bool push(const Message message) override {
+        Release release { Clock::now(), std::get<Generic>(message.getPayload()).value };
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_releases.push_back(release);
+        return true;
+    }
+
+    Message pop() override { throw std::runtime_error("Recorder is push only"); }
+    bool tryPop(Message&, std::chrono::milliseconds, PopFilter) override { return false; }
+    bool tryPopIf(Message&, PopFilter, const std::function<bool(const Message&)>&) override { return false; }
+    void requeue(const Message) override { }
+    size_t size() override { return releases().size(); }
+    bool empty() override { return size() == 0; }
+
+    // Copy of everything pushed so far
+    std::vector<Release> releases() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_releases;
+    }
+
+    // Wait until at least count releases arrived, or timeout
+    std::vector<Release> waitFor(size_t count, std::chrono::milliseconds timeout) {
+        auto deadline = Clock::now() + timeout;
+        while (size() < count && Clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return releases();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<Release> m_releases;
+};
+
+// One-shot timers on either side of the level 1 and level 2 boundaries,
+// scheduled latest first, must fire in due order and never early
+static void crossLevels() {
+    Recorder queue;
+    Scheduler scheduler(queue, TICK);
+
+    const long ticks[] = { 1, 2, 100, 254, 255, 256, 257, 258, 300, 511, 512, 513, 1000, 4096,
+                           65534, 65535, 65536, 65537, 65538, 70000, 80000 };
+    const size_t count = sizeof ticks / sizeof ticks[0];
+
+    Clock::time_point start = Clock::now() + LEAD;
+    std::vector<Clock::time_point> due(count);
+    for (size_t i = count; i-- > 0; ) {
+        due[i] = start + ticks[i] * TICK;
+        scheduler.schedule(Message(0, Generic{ static_cast<int>(i) }), due[i]);
+    }
+
+    std::vector<Release> releases = queue.waitFor(count, std::chrono::seconds(5));
+    expect(releases.size() == count, "cross levels: " + std::to_string(count) + " timers released, got "
+                                     + std::to_string(releases.size()));
+
+    for (size_t i = 0; i < releases.size(); ++i) {
+        int tag = releases[i].tag;
+        expect(tag == static_cast<int>(i), "cross levels: release " + std::to_string(i) + " is timer "
+                                           + std::to_string(i) + ", got " + std::to_string(tag));
+        expect(releases[i].time >= due[tag], "cross levels: timer " + std::to_string(tag) + " ("
+                                             + std::to_string(ticks[tag]) + " ticks) not released early");
+    }
+    expect(scheduler.pending() == 0, "cross levels: nothing left pending");
+}
+
+// Many timers at random times, some sharing a tick, are never released
+// early and come out in due order
+static void noEarlyRelease() {
+    Recorder queue;
+    Scheduler scheduler(queue, TICK);
+
+    const int count = 500;
+    std::vector<Clock::time_point> due(count);
+    Clock::time_point start = Clock::now() + LEAD;
+    uint32_t random = 39;
+    for (int i = 0; i < count; ++i) {
+        random = random * 1664525u + 1013904223u;
+        due[i] = start + std::chrono::microseconds(random % 20000);
+        scheduler.schedule(Message(0, Generic{ i }), due[i]);
+    }
+
+    std::vector<Release> releases = queue.waitFor(count, std::chrono::seconds(5));
+    expect(releases.size() == static_cast<size_t>(count), "no early release: every timer released");
+
+    int early = 0;
+    int outOfOrder = 0;
+    for (size_t i = 0; i < releases.size(); ++i) {
+        if (releases[i].time < due[releases[i].tag])
+            ++early;
+        // Timers in the same tick may come out in either order
+        if (i > 0 && due[releases[i].tag] + TICK < due[releases[i - 1].tag])
+            ++outOfOrder;
+    }
+    expect(early == 0, "no early release: " + std::to_string(early) + " timers released early");
+    expect(outOfOrder == 0, "no early release: " + std::to_string(outOfOrder) + " timers out of due order");
+}
+
+// Ids carry the node's generation, so an id whose node was reused cancels nothing
+static void staleCancel() {
+    Recorder queue;
+    Scheduler scheduler(queue, TICK);
+
+    TimerId first = scheduler.schedule(Message(0, Generic{ 1 }), std::chrono::seconds(10));
+    expect(scheduler.cancel(first), "stale cancel: a pending timer cancels");
+    expect(!scheduler.cancel(first), "stale cancel: cancelling twice returns false");
+
+    TimerId second = scheduler.schedule(Message(0, Generic{ 2 }), std::chrono::seconds(10));
+    expect(second != first, "stale cancel: the reused node gets a fresh id");
+    expect(!scheduler.cancel(first), "stale cancel: the old id does not cancel the new timer");
+    expect(scheduler.pending() == 1, "stale cancel: the new timer is still pending");
+
+    // A node freed by firing is reused the same way
+    expect(scheduler.cancel(second), "stale cancel: the new id cancels");
+    TimerId fired = scheduler.schedule(Message(0, Generic{ 3 }), std::chrono::milliseconds(1));
+    queue.waitFor(1, std::chrono::seconds(5));
+    expect(!scheduler.cancel(fired), "stale cancel: a fired timer cannot be cancelled");
+
+    TimerId third = scheduler.schedule(Message(0, Generic{ 4 }), std::chrono::seconds(10));
+    expect(!scheduler.cancel(fired), "stale cancel: the fired id does not cancel its successor");
+    expect(scheduler.pending() == 1 && scheduler.cancel(third), "stale cancel: the successor is still pending");
+}
+
+// Release k of a periodic timer is due k intervals after the first. If each
+// release were scheduled from the previous one's late wakeup, the lateness
+// would add up and releases would be lost over the run
+static void periodicNoDrift() {
+    Recorder queue;
+    Scheduler scheduler(queue, TICK);
+
+    const auto interval = std::chrono::milliseconds(2);
+    const auto run = std::chrono::milliseconds(400);
+
+    Clock::time_point start = Clock::now();
+    TimerId id = scheduler.schedulePeriodic(Message(0, Generic{ 0 }), interval);
+    std::this_thread::sleep_for(run);
+    expect(scheduler.cancel(id), "periodic: cancel stops it");
+    Clock::time_point stop = Clock::now();
+    std::vector<Release> releases = queue.releases();
+
+    int early = 0;
+    for (size_t k = 0; k < releases.size(); ++k) {
+        if (releases[k].time < start + static_cast<int>(k) * interval)
+            ++early;
+    }
+    expect(early == 0, "periodic: " + std::to_string(early) + " releases early");
+
+    // One release at the start, then one per interval up to the cancel
+    long expected = static_cast<long>((stop - start) / interval) + 1;
+    long got = static_cast<long>(releases.size());
+    expect(got <= expected && got >= expected - 3, "periodic: about " + std::to_string(expected)
+                                                   + " releases, got " + std::to_string(got));
+
+    std::this_thread::sleep_for(interval * 3);
+    expect(queue.size() == releases.size(), "periodic: nothing released after cancel");
+}
+
+int main() {
+    crossLevels();
+    noEarlyRelease();
+    staleCancel();
+    periodicNoDrift();
+
+    if (failures == 0)
+        std::cout << "Scheduler tests passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+#include "ShardedMessageQueue.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <thread>
+
+// Producer threads are numbered in the order they first push to any sharded
+// queue; the number picks the shard the thread pushes to
+static size_t producerSlot() {
+    static std::atomic<size_t> nextSlot { 0 };
+    thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+// Consumer threads are numbered separately, so they do not push producers
+// onto the same shard; the number picks the shard a consumer looks at first
+static size_t consumerSlot() {
+    static std::atomic<size_t> nextSlot { 0 };
+    thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+ShardedMessageQueue::ShardedMessageQueue(size_t shards) {
+    if (shards == 0)
+        shards = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < shards; ++i)
+        m_shards.push_back(std::make_unique<Shard>());
+}
+
+ShardedMessageQueue::~ShardedMessageQueue() { }
+
+//-------------------------------//
+/* DATA CREATION AND DESTRUCTION */
+//-------------------------------//
+
+/*
+ * Add message into the calling thread's shard
+ */
+bool ShardedMessageQueue::push(const Message message) {
+    return push(message, producerSlot());
+}
+
+/*
+ * Add message into the producer's shard depending on priority
+ */
+bool ShardedMessageQueue::push(const Message message, size_t producer) {
+    Shard& shard = *m_shards[producer % m_shards.size()];
+    bool priority = message.isHighPriority();
+
+    {
+        // Thread acquires this shard's lock only
+        std::unique_lock<std::mutex> lock(shard.mutex);
+
+        // Check for the shard's limit
+        if (shard.priority.size() + shard.regular.size() >= QUEUE_LIMIT) {
+            lock.unlock();
+            std::cerr << "Queue limit reached. push discarded" << std::endl;
+            return false;
+        }
+
+        // Counts change under the shard lock so a consumer cannot take the
+        // message before it is counted
+        Lane& lane = priority ? shard.priority : shard.regular;
+        lane.push_back(message);
+        Tracer::instance().onPush(lane.back());
+        (priority ? shard.priorityCount : shard.regularCount).fetch_add(1);
+    }
+
+    notifyPushed();
+    return true;
+}
+
+/*
+ * Remove the next message, blocking until one is available
+ */
+Message ShardedMessageQueue::pop() {
+    Message message;
+    while (!tryPop(message, std::chrono::milliseconds::max(), PopFilter::Any))
+        ;
+    return message;
+}
+
+/*
+ * Remove the next message, waiting at most timeout
+ */
+bool ShardedMessageQueue::tryPop(Message& message, std::chrono::milliseconds timeout, PopFilter filter) {
+    if (steal(message, filter))
+        return true;
+
+    bool forever = (timeout == std::chrono::milliseconds::max());
+    auto deadline = std::chrono::steady_clock::now() + (forever ? std::chrono::milliseconds(0) : timeout);
+    auto ready = [this, filter]() { return has(filter); };
+    bool filtered = (filter != PopFilter::Any);
+
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    m_sleepers.fetch_add(1);
+    m_filteredSleepers.fetch_add(filtered);
+
+    bool found = false;
+    while (!found) {
+        // Waits for a signal from push() if every shard is empty
+        if (forever)
+            m_cond_push.wait(lock, ready);
+        else if (!m_cond_push.wait_until(lock, deadline, ready))
+            break;
+
+        // Another consumer may win the race for the message; wait again then
+        lock.unlock();
+        found = steal(message, filter);
+        lock.lock();
+    }
+
+    m_filteredSleepers.fetch_sub(filtered);
+    m_sleepers.fetch_sub(1);
+    return found;
+}
+
+/*
+ * Remove the first front message the caller accepts, scanning like tryPop
+ */
+bool ShardedMessageQueue::tryPopIf(Message& message, PopFilter filter,
+                                   const std::function<bool(const Message&)>& accept) {
+    return steal(message, filter, &accept);
+}
+
+/*
+ * Put an undelivered message back at the front of the shard it was popped
+ * from, so it goes out again before its producer's later messages. Messages
+ * that did not come from this queue go to the caller's home shard
+ */
+void ShardedMessageQueue::requeue(const Message message) {
+    size_t origin = message.origin();
+    Shard& shard = *m_shards[(origin > 0 && origin <= m_shards.size()) ? origin - 1 : homeShard()];
+    bool priority = message.isHighPriority();
+
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        Lane& lane = priority ? shard.priority : shard.regular;
+        if (!lane.push_front(message)) {
+            lock.unlock();
+            std::cerr << "Queue reserve exhausted. requeue discarded" << std::endl;
+            return;
+        }
+        (priority ? shard.priorityCount : shard.regularCount).fetch_add(1);
+    }
+
+    notifyPushed();
+}
+
+/*
+ * Only take the wait lock if a consumer may be sleeping. The lock makes sure
+ * the notification cannot slip in between its check and its wait. Consumers
+ * restricted to one lane may not be able to take the message, so all are
+ * woken while there are any
+ */
+void ShardedMessageQueue::notifyPushed() {
+    if (m_sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        if (m_filteredSleepers.load() > 0)
+            m_cond_push.notify_all();
+        else
+            m_cond_push.notify_one();
+    }
+}
+
+/*
+ * Returns if the lanes allowed by filter hold a message in any shard
+ */
+bool ShardedMessageQueue::has(PopFilter filter) const {
+    for (const auto& shard : m_shards) {
+        if ((filter != PopFilter::RegularOnly && shard->priorityCount.load() > 0)
+            || (filter != PopFilter::PriorityOnly && shard->regularCount.load() > 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Scan priority lanes of every shard, then regular lanes, from the home shard
+ */
+bool ShardedMessageQueue::steal(Message& message, PopFilter filter,
+                                const std::function<bool(const Message&)>* accept) {
+    size_t home = homeShard();
+    size_t count = m_shards.size();
+
+    if (filter != PopFilter::RegularOnly) {
+        for (size_t i = 0; i < count; ++i) {
+            if (popFrom((home + i) % count, true, message, accept))
+                return true;
+        }
+    }
+
+    if (filter == PopFilter::PriorityOnly)
+        return false;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (popFrom((home + i) % count, false, message, accept))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Pop from one lane of a shard, skipping it without locking if it looks empty.
+ * The message remembers the shard for requeue()
+ */
+bool ShardedMessageQueue::popFrom(size_t index, bool priority, Message& message,
+                                  const std::function<bool(const Message&)>* accept) {
+    Shard& shard = *m_shards[index];
+    std::atomic<size_t>& laneCount = priority ? shard.priorityCount : shard.regularCount;
+    if (laneCount.load() == 0)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Lane& lane = priority ? shard.priority : shard.regular;
+        if (lane.empty() || (accept != nullptr && !(*accept)(lane.front())))
+            return false;
+
+        message = lane.pop_front();
+        laneCount.fetch_sub(1);
+        message.setOrigin(static_cast<uint32_t>(index + 1));
+    }
+
+    Tracer::instance().record(message.traceId(), TraceStage::Pop);
+    return true;
+}
+
+//----------------//
+/* DATA RETRIEVAL */
+//----------------//
+
+/*
+ * Returns how many elements are in all shards (a snapshot; shards are read
+ * one after another)
+ */
+size_t ShardedMessageQueue::size() {
+    size_t count = 0;
+    for (const auto& shard : m_shards)
+        count += shard->priorityCount.load() + shard->regularCount.load();
+    return count;
+}
+
+/*
+ * Returns if every shard is empty (True) or not (False)
+ */
+bool ShardedMessageQueue::empty() { return !has(PopFilter::Any); }
+
+/*
+ * Returns the number of shards
+ */
+size_t ShardedMessageQueue::shards() const { return m_shards.size(); }
+
+/*
+ * Returns the calling thread's home shard
+ */
+size_t ShardedMessageQueue::homeShard() const { return consumerSlot() % m_shards.size(); }
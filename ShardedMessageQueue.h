@@ -0,0 +1,133 @@
+#ifndef SHARDED_QUEUE_H
+#define SHARDED_QUEUE_H
+
+#include "IMessageQueue.h"
+#include "MessageQueue.h"
+#include "RingBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#pragma once
+
+// Message queue split into independently locked shards so that producers on
+// different threads do not contend on one mutex.
+//
+// Each producer thread is pinned to one shard, which keeps its messages in
+// FIFO order. Producers and consumers are numbered separately, so producers
+// spread across the shards however many consumers there are. Consumers start
+// at their own home shard and steal from the others when it is empty. Counts
+// are kept per shard and only summed when the whole queue is asked about, so
+// no counter is shared by every push and pop. A requeued message goes back to
+// the front of the shard it was popped from, so it keeps its place ahead of
+// its producer's later messages. High priority messages in any shard are popped
+// before regular messages in any shard, as with MessageQueue.
+//
+// Example Usage:
+//   ShardedMessageQueue queue(4);
+//   queue.push(Message(1, WheelMessage{10, 20, 30}));
+//   Message msg = queue.pop();
+class ShardedMessageQueue : public IMessageQueue {
+public:
+    /** Constructor for ShardedMessageQueue
+     *
+     * @param
+     * shards (size_t): number of shards (0 = one per hardware thread). Each
+     *                  shard holds up to QUEUE_LIMIT messages
+     */
+    explicit ShardedMessageQueue(size_t shards = 0);
+    ~ShardedMessageQueue() override;
+
+    bool push(const Message message) override;
+
+    /** Add message into the given producer's shard
+     *
+     * @param
+     * message (Message): the Message object being added to the queue
+     * producer (size_t): producer id; messages with the same id stay in order
+     *
+     * @return
+     * (bool) if the message was queued (True) or the shard is full (False)
+     */
+    bool push(const Message message, size_t producer);
+
+    Message pop() override;
+    bool tryPop(Message& message, std::chrono::milliseconds timeout,
+                PopFilter filter = PopFilter::Any) override;
+    bool tryPopIf(Message& message, PopFilter filter,
+                  const std::function<bool(const Message&)>& accept) override;
+    void requeue(const Message message) override;
+    size_t size() override;
+    bool empty() override;
+
+    /** Returns the number of shards
+     *
+     * @param
+     * none
+     *
+     * @return
+     * (size_t) the number of shards
+     */
+    size_t shards() const;
+
+private:
+    using Lane = RingBuffer<Message, QUEUE_LIMIT + QUEUE_REQUEUE_RESERVE>;
+
+    // One independently locked pair of lanes, padded to its own cache lines
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        Lane priority;
+        Lane regular;
+        std::atomic<size_t> priorityCount { 0 }; // Readable without the lock
+        std::atomic<size_t> regularCount { 0 };
+    };
+
+    /** Pop from the first non-empty lane, priority lanes across all shards first
+     *
+     * @param
+     * message (Message&): receives the popped Message object
+     * filter (PopFilter): the lanes that may be popped
+     * accept (const std::function<bool(const Message&)>*): if set, lanes whose front it rejects are skipped
+     *
+     * @return
+     * (bool) if a message was found (True) or every shard was empty (False)
+     */
+    bool steal(Message& message, PopFilter filter,
+               const std::function<bool(const Message&)>* accept = nullptr);
+
+    // If the lanes allowed by filter hold a message in any shard
+    bool has(PopFilter filter) const;
+
+    // Wake a consumer after a push if any may be sleeping
+    void notifyPushed();
+
+    /** Pop from one lane of one shard if it has a message
+     *
+     * @param
+     * index (size_t): the shard to pop from
+     * priority (bool): pop from the priority lane (True) or regular lane (False)
+     * message (Message&): receives the popped Message object
+     * accept (const std::function<bool(const Message&)>*): if set, the front is only popped if it accepts it
+     *
+     * @return
+     * (bool) if a message was popped
+     */
+    bool popFrom(size_t index, bool priority, Message& message,
+                 const std::function<bool(const Message&)>* accept = nullptr);
+
+    // Index of the calling consumer's shard (pops, and requeues of messages from elsewhere)
+    size_t homeShard() const;
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    // Consumers sleep here only when every shard is empty. Pushes read the
+    // sleeper counts, so they get their own cache line
+    std::mutex m_waitMutex;
+    std::condition_variable m_cond_push;
+    alignas(64) std::atomic<size_t> m_sleepers { 0 };
+    std::atomic<size_t> m_filteredSleepers { 0 };   // Sleepers that only take one lane
+};
+
+#endif
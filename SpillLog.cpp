@@ -0,0 +1,222 @@
+#include "SpillLog.h"
+#include "TextCodec.h"
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string.h>
+
+namespace bip = boost::interprocess;
+
+// Make sure the file exists with the size the config asks for, so it can be mapped
+static const char* prepareFile(const SpillConfig& config, size_t headerSize) {
+    std::error_code ec;
+    uintmax_t size = headerSize + config.capacity;
+
+    if (!std::filesystem::exists(config.path, ec))
+        std::ofstream(config.path, std::ios::binary);
+    if (std::filesystem::file_size(config.path, ec) != size)
+        std::filesystem::resize_file(config.path, size, ec);
+    if (ec)
+        throw std::runtime_error("Cannot create spill file " + config.path + ": " + ec.message());
+
+    return config.path.c_str();
+}
+
+// Constructor
+SpillLog::SpillLog(const SpillConfig& config) try :
+    m_config(config),
+    m_file(prepareFile(m_config, HEADER_SIZE), bip::read_write),
+    m_region(m_file, bip::read_write)
+{
+    Header* h = header();
+    if (h->magic == MAGIC && h->version == VERSION && h->capacity == m_config.capacity) {
+        recover();
+    } else {
+        initialize();
+    }
+
+    m_flusher = std::thread(&SpillLog::flushLoop, this);
+} catch (const bip::interprocess_exception& e) {
+    throw std::runtime_error("Cannot map spill file " + config.path + ": " + e.what());
+}
+
+// Destructor
+SpillLog::~SpillLog() {
+    {
+        std::lock_guard<std::mutex> lock(m_flushMutex);
+        m_stopping = true;
+    }
+    m_flushCond.notify_one();
+    m_flusher.join();
+    sync();
+}
+
+// Spill only the formats the config marks as durable
+bool SpillLog::accepts(const Message& message) const {
+    int format = static_cast<int>(message.getFormat());
+    if (format >= 0 && format < 3)
+        return m_config.spill[format];
+    return m_config.spillGeneric;
+}
+
+/*
+ * Copy the message's encoding to the tail, wrapping to the start of the data
+ * area if the record does not fit before the end. An offset that reaches the
+ * end exactly always wraps to 0, so no record is ever placed at the end
+ */
+bool SpillLog::append(const Message& message) {
+    EncodedBuffer bytes = message.encoded();
+    uint32_t length = static_cast<uint32_t>(bytes->size());
+    uint64_t need = sizeof(length) + length;
+
+    Header* h = header();
+    uint64_t tail = h->tail == h->capacity ? 0 : h->tail;
+    uint64_t pad = (h->capacity - tail < need) ? h->capacity - tail : 0;
+    if (h->used + pad + need > h->capacity)
+        return false;
+
+    // The space left before the end is skipped; mark it if there is room to
+    if (pad > 0) {
+        if (pad >= sizeof(WRAP))
+            memcpy(data() + tail, &WRAP, sizeof(WRAP));
+        tail = 0;
+    }
+
+    memcpy(data() + tail, &length, sizeof(length));
+    memcpy(data() + tail + sizeof(length), bytes->data(), length);
+
+    h->tail = tail + need;
+    if (h->tail == h->capacity)
+        h->tail = 0;
+    h->used += pad + need;
+    h->count += 1;
+
+    if (m_unsynced.fetch_add(1, std::memory_order_relaxed) + 1 == m_config.flushBatch)
+        m_flushCond.notify_one();
+    return true;
+}
+
+/*
+ * Decode the record at the head and release its space
+ */
+bool SpillLog::pop(Message& message) {
+    Header* h = header();
+    while (h->count > 0) {
+        uint64_t head = h->head;
+        uint32_t length = WRAP;
+        if (h->capacity - head >= sizeof(length))
+            memcpy(&length, data() + head, sizeof(length));
+
+        // Skip the padding left where an append wrapped
+        if (length == WRAP) {
+            h->used -= h->capacity - head;
+            head = 0;
+            memcpy(&length, data(), sizeof(length));
+        }
+
+        DecodeResult result = TextCodec::decode(
+            std::string_view(data() + head + sizeof(length), length), message);
+
+        h->head = head + sizeof(length) + length;
+        if (h->head == h->capacity)
+            h->head = 0;
+        h->used -= sizeof(length) + length;
+        h->count -= 1;
+        if (h->count == 0)
+            h->head = h->tail = h->used = 0;
+        m_unsynced.fetch_add(1, std::memory_order_relaxed);
+
+        if (result)
+            return true;
+        std::cerr << "Spill record unreadable (" << TextCodec::errorString(result.error)
+                  << "). skipped" << std::endl;
+    }
+    return false;
+}
+
+// Flush the whole mapping synchronously
+void SpillLog::sync() {
+    m_unsynced.store(0, std::memory_order_relaxed);
+    m_region.flush(0, 0, false);
+}
+
+/*
+ * Fresh (or incompatible) file: start with an empty log
+ */
+void SpillLog::initialize() {
+    Header* h = header();
+    memset(h, 0, sizeof(Header));
+    h->magic = MAGIC;
+    h->version = VERSION;
+    h->capacity = m_config.capacity;
+    sync();
+}
+
+/*
+ * Walk the records left by the previous run. A crash between syncs can leave
+ * the header ahead of the data, so the log is cut at the first bad record
+ */
+void SpillLog::recover() {
+    Header* h = header();
+    uint64_t pos = h->head;
+    uint64_t used = 0;
+    uint64_t count = 0;
+    bool valid = h->head < h->capacity && h->used <= h->capacity;
+
+    while (valid && count < h->count) {
+        uint32_t length = WRAP;
+        if (h->capacity - pos >= sizeof(length))
+            memcpy(&length, data() + pos, sizeof(length));
+        if (length == WRAP) {
+            used += h->capacity - pos;
+            pos = 0;
+            memcpy(&length, data(), sizeof(length));
+        }
+
+        Message message;
+        if (length > h->capacity - pos - sizeof(length)
+            || !TextCodec::decode(std::string_view(data() + pos + sizeof(length), length), message)) {
+            break;
+        }
+
+        pos += sizeof(length) + length;
+        if (pos == h->capacity)
+            pos = 0;
+        used += sizeof(length) + length;
+        ++count;
+    }
+
+    if (!valid || count != h->count) {
+        std::cerr << "Spill file " << m_config.path << ": kept " << count << " of "
+                  << h->count << " records" << std::endl;
+    }
+    if (!valid) {
+        initialize();
+        return;
+    }
+
+    h->tail = pos;
+    h->used = used;
+    h->count = count;
+    if (count == 0)
+        h->head = h->tail = h->used = 0;
+    sync();
+}
+
+/*
+ * Sync every flushInterval, or sooner once flushBatch messages are waiting
+ */
+void SpillLog::flushLoop() {
+    std::unique_lock<std::mutex> lock(m_flushMutex);
+    while (!m_stopping) {
+        m_flushCond.wait_for(lock, m_config.flushInterval, [this]() {
+            return m_stopping || m_unsynced.load(std::memory_order_relaxed) >= m_config.flushBatch;
+        });
+        if (m_unsynced.load(std::memory_order_relaxed) == 0)
+            continue;
+
+        lock.unlock();
+        sync();
+        lock.lock();
+    }
+}
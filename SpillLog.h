@@ -0,0 +1,140 @@
+#ifndef SPILL_LOG_H
+#define SPILL_LOG_H
+
+#include "Message.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+#pragma once
+
+// Where and how a MessageQueue spills regular messages to disk
+struct SpillConfig {
+    std::string path;                         // Segment file (created if missing, resumed if valid)
+    size_t capacity = 16 * 1024 * 1024;       // Bytes of message data the file can hold
+    std::chrono::milliseconds flushInterval { 100 }; // Longest time spilled data stays unsynced
+    size_t flushBatch = 256;                  // Sync early once this many messages are unsynced
+
+    // Regular-priority formats worth keeping through an outage. Setpoints are
+    // stale by the time a link comes back, so they are dropped as before
+    bool spill[3] = { false, false, true };   // wheel, arm, science tool
+    bool spillGeneric = true;                 // Generic messages (logged commands)
+};
+
+// Bounded, append-only FIFO of encoded messages in a memory-mapped file.
+//
+// The file is a fixed-size circular log: a header page holding the read and
+// write offsets, followed by length-prefixed records that wrap around at the
+// end. Appends and pops are plain memory copies into the mapping; a flusher
+// thread syncs the mapping to disk in batches, so callers never wait on the
+// disk. On open, records left by a previous run are validated and resumed.
+//
+// append() and pop() are not thread safe; MessageQueue calls them under its
+// own lock.
+class SpillLog {
+public:
+    /** Opens (or creates) the segment file and starts the flusher thread
+     *
+     * @param
+     *  config: const SpillConfig& - File location, size and flush policy
+     *
+     * Throws std::runtime_error if the file cannot be created or mapped.
+     */
+    explicit SpillLog(const SpillConfig& config);
+
+    // Syncs outstanding data and stops the flusher
+    ~SpillLog();
+
+    SpillLog(const SpillLog&) = delete;
+    SpillLog& operator=(const SpillLog&) = delete;
+
+    /** Returns if a message should go to disk when memory is full
+     *
+     * @param
+     *  message: const Message& - A regular-priority message
+     *
+     * @return
+     *  bool - True if its format is configured to spill
+     */
+    bool accepts(const Message& message) const;
+
+    /** Appends a message at the back of the log
+     *
+     * @param
+     *  message: const Message& - The message to keep
+     *
+     * @return
+     *  bool - True if it was written, False if the file is full
+     */
+    bool append(const Message& message);
+
+    /** Removes the oldest message from the log
+     *
+     * @param
+     *  message: Message& - Receives the message
+     *
+     * @return
+     *  bool - True if a message was returned, False if the log is empty
+     */
+    bool pop(Message& message);
+
+    /** Writes everything appended so far to disk before returning
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  none
+     */
+    void sync();
+
+    size_t size() const { return static_cast<size_t>(header()->count); }
+    bool empty() const { return header()->count == 0; }
+
+private:
+    // Stored at the start of the file
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t capacity;   // Bytes in the data area
+        uint64_t head;       // Offset of the oldest record in the data area
+        uint64_t tail;       // Offset where the next record goes
+        uint64_t used;       // Bytes taken by records and wrap padding
+        uint64_t count;      // Records in the log
+    };
+
+    static constexpr uint64_t MAGIC = 0x4c4c495053565252ull; // "RRVSPILL"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 4096;              // Data starts on its own page
+    static constexpr uint32_t WRAP = 0xFFFFFFFFu;            // Record length marking a wrap
+
+    Header* header() const { return static_cast<Header*>(m_region.get_address()); }
+    char* data() const { return static_cast<char*>(m_region.get_address()) + HEADER_SIZE; }
+
+    // Start empty, or walk the records of a previous run and keep the valid ones
+    void initialize();
+    void recover();
+
+    // Flusher thread body
+    void flushLoop();
+
+    SpillConfig m_config;
+    boost::interprocess::file_mapping m_file;
+    boost::interprocess::mapped_region m_region;
+
+    std::thread m_flusher;
+    std::mutex m_flushMutex;
+    std::condition_variable m_flushCond;
+    std::atomic<size_t> m_unsynced { 0 };    // Appends since the last sync
+    bool m_stopping = false;                 // Guarded by m_flushMutex
+};
+
+#endif
@@ -0,0 +1,153 @@
+// Checks that the spill log wraps correctly when a record ends exactly at the
+// end of the data area, both while running and after reopening the file, and
+// that a MessageQueue spilling over to it keeps FIFO order across the
+// memory/disk boundary.
+// Run through ctest, or directly: ./bin/SpillLogTest [scratch file]
+
+#include "MessageQueue.h"
+#include "SpillLog.h"
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+// Report a failed check
+static void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAIL: " << what << "\n";
+        ++failures;
+    }
+}
+
+// Pop everything and return the Generic values in order
+static std::vector<int> drain(SpillLog& log) {
+    std::vector<int> values;
+    Message message;
+    while (log.pop(message))
+        values.push_back(std::get<Generic>(message.getPayload()).value);
+    return values;
+}
+
+// Three records fill the data area exactly, so the fourth append lands where
+// the tail reaches the end and must start again at offset 0
+static void wrapAtExactEnd(const std::string& path, bool reopen) {
+    std::filesystem::remove(path);
+
+    // Single-digit values all encode to the same length
+    size_t record = sizeof(uint32_t) + Message(0, Generic{1}).encoded()->size();
+    SpillConfig config;
+    config.path = path;
+    config.capacity = 3 * record;
+
+    std::string name = reopen ? "wrap at exact end, reopened" : "wrap at exact end";
+    std::vector<int> values;
+    {
+        SpillLog log(config);
+        expect(log.append(Message(0, Generic{1})), name + ": append 1");
+        expect(log.append(Message(0, Generic{2})), name + ": append 2");
+        expect(log.append(Message(0, Generic{3})), name + ": append 3");
+        expect(!log.append(Message(0, Generic{9})), name + ": append to a full log is refused");
+
+        Message message;
+        expect(log.pop(message) && std::get<Generic>(message.getPayload()).value == 1, name + ": pop 1");
+        expect(log.append(Message(0, Generic{4})), name + ": append 4 after the wrap");
+
+        if (!reopen)
+            values = drain(log);
+    }
+    if (reopen) {
+        SpillLog log(config);
+        expect(log.size() == 3, name + ": three records recovered");
+        values = drain(log);
+    }
+
+    expect(values == std::vector<int>({ 2, 3, 4 }), name + ": pops return 2, 3, 4");
+    std::filesystem::remove(path);
+}
+
+// The number a test message carries (Generic value, science tool xPos)
+static int tag(const Message& message) {
+    if (auto generic = std::get_if<Generic>(&message.getPayload()))
+        return generic->value;
+    if (auto science = std::get_if<ScienceToolMessage>(&message.getPayload()))
+        return science->xPos;
+    return -1;
+}
+
+// Fill the queue to its limit, then keep pushing: science tool and generic
+// messages spill to disk, wheel setpoints are dropped. Popping must return
+// everything accepted in push order while the disk backlog refills memory
+static void queueSpillOrder(const std::string& path) {
+    std::filesystem::remove(path);
+
+    SpillConfig config;
+    config.path = path;
+    config.capacity = 64 * 1024;
+
+    std::string name = "queue spill";
+    std::vector<int> pushed;
+    std::vector<int> popped;
+    {
+        MessageQueue queue;
+        queue.enableSpill(config);
+
+        for (int i = 0; i < QUEUE_LIMIT; ++i) {
+            expect(queue.push(Message(0, Generic{ i })), name + ": push " + std::to_string(i) + " into memory");
+            pushed.push_back(i);
+        }
+        expect(queue.sizeSpilled() == 0, name + ": nothing spilled below the limit");
+
+        const int EXTRA = 30;
+        size_t spilled = 0;
+        for (int i = QUEUE_LIMIT; i < QUEUE_LIMIT + EXTRA; ++i) {
+            switch (i % 3) {
+                case 0:
+                    expect(queue.push(Message(0, ScienceToolMessage{ 0, 0, i, 0 })), name + ": science tool spilled");
+                    pushed.push_back(i);
+                    ++spilled;
+                    break;
+                case 1:
+                    expect(queue.push(Message(0, Generic{ i })), name + ": generic spilled");
+                    pushed.push_back(i);
+                    ++spilled;
+                    break;
+                default:
+                    expect(!queue.push(Message(0, WheelMessage{ i, 0, 0 })), name + ": wheel setpoint dropped");
+                    break;
+            }
+        }
+        expect(queue.sizeSpilled() == spilled, name + ": " + std::to_string(spilled) + " messages on disk");
+        expect(queue.sizeRegular() - queue.sizeSpilled() == QUEUE_LIMIT, name + ": memory stays at the limit");
+        expect(queue.size() == QUEUE_LIMIT + spilled && queue.sizeRegular() == QUEUE_LIMIT + spilled,
+               name + ": size() and sizeRegular() count memory and disk");
+
+        // Each pop moves the oldest spilled message back into memory
+        while (!queue.empty()) {
+            popped.push_back(tag(queue.pop()));
+            size_t onDisk = spilled > popped.size() ? spilled - popped.size() : 0;
+            if (queue.sizeSpilled() != onDisk) {
+                expect(false, name + ": " + std::to_string(onDisk) + " left on disk after "
+                              + std::to_string(popped.size()) + " pops");
+                break;
+            }
+        }
+        expect(queue.size() == 0 && queue.sizeSpilled() == 0, name + ": drained");
+    }
+
+    expect(popped == pushed, name + ": pops return every accepted message in push order");
+    std::filesystem::remove(path);
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "spill_log_test.bin";
+
+    wrapAtExactEnd(path, false);
+    wrapAtExactEnd(path, true);
+    queueSpillOrder(path);
+
+    if (failures == 0)
+        std::cout << "SpillLog tests passed\n";
+    return failures == 0 ? 0 : 1;
+}
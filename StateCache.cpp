@@ -0,0 +1,35 @@
+#include "StateCache.h"
+#include "WebsocketClient.h"
+
+// Copy the payload into the slot for its format
+bool StateCache::update(const Message& message) {
+    auto now = std::chrono::steady_clock::now();
+    bool priority = message.isHighPriority();
+
+    return std::visit([&](auto&& payload) {
+        using T = std::decay_t<decltype(payload)>;
+
+        if constexpr (std::is_same_v<T, WheelMessage>)
+            m_wheel.store(payload, priority, now);
+        else if constexpr (std::is_same_v<T, ArmMessage>)
+            m_arm.store(payload, priority, now);
+        else if constexpr (std::is_same_v<T, ScienceToolMessage>)
+            m_scienceTool.store(payload, priority, now);
+        else
+            return false;
+        return true;
+    }, message.getPayload());
+}
+
+// Keep the cache current until receive() reports the connection is gone
+void StateCache::pump(WebSocketClient& client, std::function<void(const Message&)> other) {
+    try {
+        while (true) {
+            Message message = client.receive();
+            if (!update(message) && other)
+                other(message);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "State cache stopped: " << e.what() << "\n";
+    }
+}
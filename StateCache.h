@@ -0,0 +1,194 @@
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include "Message.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#pragma once
+
+class WebSocketClient;
+
+// Latest value of one message format as seen by a reader
+template <typename T>
+struct StateSnapshot {
+    T value {};                          // The payload (zeroed if never received)
+    uint64_t sequence = 0;               // Updates so far (0 = never received)
+    std::chrono::nanoseconds age { 0 };  // Time since the update was stored
+    bool highPriority = false;           // Priority of the message it came from
+
+    explicit operator bool() const { return sequence != 0; }
+};
+
+// Single-writer, multi-reader slot holding the latest value of T.
+//
+// A seqlock: the writer makes the sequence odd, stores the value, then makes
+// it even again; readers retry if the sequence changed underneath them. The
+// payload is stored as relaxed atomic words so concurrent reads are well
+// defined. Readers never block the writer, and only retry while a store is
+// in progress.
+template <typename T>
+class SeqlockSlot {
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(int) == 0,
+                  "SeqlockSlot stores structs of ints");
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Store a new value (one writer thread only)
+    void store(const T& value, bool highPriority, Clock::time_point time) {
+        std::array<int, WORDS> words;
+        memcpy(words.data(), &value, sizeof(T));
+
+        uint64_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORDS; ++i)
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        m_time.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+        m_highPriority.store(highPriority, std::memory_order_relaxed);
+
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Read a consistent copy of the latest value (any thread)
+    StateSnapshot<T> load() const {
+        StateSnapshot<T> snapshot;
+        std::array<int, WORDS> words;
+        Clock::rep time;
+        uint64_t before;
+
+        for (unsigned spins = 0; ; ++spins) {
+            before = m_seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                wait(spins);   // A store is in progress
+                continue;
+            }
+
+            for (size_t i = 0; i < WORDS; ++i)
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            time = m_time.load(std::memory_order_relaxed);
+            snapshot.highPriority = m_highPriority.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_seq.load(std::memory_order_relaxed) == before)
+                break;
+        }
+
+        if (before == 0)
+            return StateSnapshot<T>();
+
+        memcpy(&snapshot.value, words.data(), sizeof(T));
+        snapshot.sequence = before / 2;
+        snapshot.age = Clock::now() - Clock::time_point(Clock::duration(time));
+        return snapshot;
+    }
+
+private:
+    static constexpr size_t WORDS = sizeof(T) / sizeof(int);
+
+    // Back off while a store is in progress: pause the core (so the spin
+    // does not starve a sibling hyperthread), and give up the CPU if the
+    // writer seems to have been descheduled mid-store
+    static void wait(unsigned spins) {
+        if (spins >= 64) {
+            std::this_thread::yield();
+            return;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
+    // Own cache line so readers of one slot do not slow the writer of another
+    alignas(64) std::atomic<uint64_t> m_seq { 0 };   // Odd while a store is in progress
+    std::atomic<int> m_words[WORDS] {};
+    std::atomic<Clock::rep> m_time { 0 };
+    std::atomic<bool> m_highPriority { false };
+};
+
+// Latest WheelMessage, ArmMessage and ScienceToolMessage received by a client.
+//
+// Fixed-rate control loops read the newest setpoint (with its sequence number
+// and age) without locks and without waiting on the network, while one
+// receive thread keeps the cache current.
+//
+// Example Usage:
+//   StateCache cache;
+//   std::thread([&]() { cache.pump(client); }).detach();
+//   ...
+//   auto wheel = cache.latest<WheelMessage>();   // In the control loop
+//   if (wheel && wheel.age < std::chrono::milliseconds(200))
+//       drive(wheel.value);
+class StateCache {
+public:
+    /** Stores a message in the slot for its format (one writer thread only).
+     * Other formats are ignored
+     *
+     * @param
+     *  message: const Message& - A received message
+     *
+     * @return
+     *  bool - True if the message was cached
+     */
+    bool update(const Message& message);
+
+    /** Returns the latest value of a format. Lock-free; safe from any thread
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  StateSnapshot<T> - The value, its sequence number and age (false if
+     *                     nothing has been received yet)
+     */
+    template <typename T>
+    StateSnapshot<T> latest() const { return slot<T>().load(); }
+
+    /** Receives from the client into the cache until the connection is lost.
+     * Run it on its own thread; this is the cache's single writer
+     *
+     * @param
+     *  client: WebSocketClient& - A connected client
+     *  other: std::function<void(const Message&)> - Called for messages the
+     *         cache does not hold (optional)
+     *
+     * @return
+     *  none
+     */
+    void pump(WebSocketClient& client, std::function<void(const Message&)> other = nullptr);
+
+private:
+    template <typename T>
+    const SeqlockSlot<T>& slot() const {
+        if constexpr (std::is_same_v<T, WheelMessage>)
+            return m_wheel;
+        else if constexpr (std::is_same_v<T, ArmMessage>)
+            return m_arm;
+        else {
+            static_assert(std::is_same_v<T, ScienceToolMessage>,
+                          "StateCache holds WheelMessage, ArmMessage and ScienceToolMessage");
+            return m_scienceTool;
+        }
+    }
+
+    SeqlockSlot<WheelMessage> m_wheel;
+    SeqlockSlot<ArmMessage> m_arm;
+    SeqlockSlot<ScienceToolMessage> m_scienceTool;
+};
+
+#endif
@@ -0,0 +1,97 @@
+// Checks that StateCache readers never see a torn value: one writer stores
+// ~2M ArmMessages whose fields all hold the same number while a reader spins
+// on load(), and every snapshot must hold a single number matching its
+// sequence.
+// Run through ctest, or directly: ./bin/StateCacheTest [updates]
+
+#include "StateCache.h"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+
+static int failures = 0;
+
+// Report a failed check
+static void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cerr << "FAIL: " << what << "\n";
+        ++failures;
+    }
+}
+
+// Every field of the arm message set to n
+static ArmMessage uniform(int n) {
+    return ArmMessage{ n, n, n, n, n, n, n, n };
+}
+
+// The common value of all fields, or -1 if they differ
+static int common(const ArmMessage& arm) {
+    const int fields[8] = { arm.armXPos, arm.armYPos, arm.armZPos, arm.clawXPos,
+                            arm.clawYPos, arm.clawOpen, arm.clawRotation, arm.wristRotation };
+    for (int field : fields) {
+        if (field != fields[0])
+            return -1;
+    }
+    return fields[0];
+}
+
+static void tornReads(int updates) {
+    SeqlockSlot<ArmMessage> slot;
+    expect(!slot.load(), "an empty slot reads as never received");
+
+    std::atomic<bool> started { false };
+    std::atomic<bool> done { false };
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    uint64_t mismatched = 0;
+    uint64_t backwards = 0;
+    uint64_t last = 0;
+
+    std::thread reader([&]() {
+        started.store(true, std::memory_order_release);
+        while (!done.load(std::memory_order_acquire)) {
+            StateSnapshot<ArmMessage> snapshot = slot.load();
+            ++reads;
+            if (!snapshot)
+                continue;
+
+            // Store k writes the value k, with high priority on odd k
+            int value = common(snapshot.value);
+            if (value < 0)
+                ++torn;
+            else if (static_cast<uint64_t>(value) != snapshot.sequence
+                     || snapshot.highPriority != (value % 2 == 1))
+                ++mismatched;
+            if (snapshot.sequence < last)
+                ++backwards;
+            last = snapshot.sequence;
+        }
+    });
+
+    // Only race once the reader is spinning, or a fast writer could finish first
+    while (!started.load(std::memory_order_acquire))
+        std::this_thread::yield();
+    for (int k = 1; k <= updates; ++k)
+        slot.store(uniform(k), k % 2 == 1, SeqlockSlot<ArmMessage>::Clock::now());
+    done.store(true, std::memory_order_release);
+    reader.join();
+
+    StateSnapshot<ArmMessage> latest = slot.load();
+    expect(latest.sequence == static_cast<uint64_t>(updates) && common(latest.value) == updates,
+           "the last store is read back");
+    expect(reads > 0, "the reader ran");
+    expect(torn == 0, std::to_string(torn) + " of " + std::to_string(reads) + " snapshots mixed two stores");
+    expect(mismatched == 0, std::to_string(mismatched) + " snapshots did not match their sequence");
+    expect(backwards == 0, std::to_string(backwards) + " snapshots went back in time");
+}
+
+int main(int argc, char** argv) {
+    int updates = argc > 1 ? std::stoi(argv[1]) : 2000000;
+
+    tornReads(updates);
+
+    if (failures == 0)
+        std::cout << "StateCache tests passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+#include "TextCodec.h"
+#include <charconv>
+#include <stdint.h>
+#include <string.h>
+
+// Appends space-separated ints to a buffer known to be large enough
+class TextWriter {
+public:
+    explicit TextWriter(char* out) : m_begin(out), m_pos(out) { }
+
+    TextWriter& field(int value) {
+        if (m_pos != m_begin)
+            *m_pos++ = ' ';
+        m_pos = std::to_chars(m_pos, m_pos + 11, value).ptr; // 11 = "-2147483648"
+        return *this;
+    }
+
+    // Appends " key=value"
+    TextWriter& tag(char key, uint64_t value) {
+        *m_pos++ = ' ';
+        *m_pos++ = key;
+        *m_pos++ = '=';
+        m_pos = std::to_chars(m_pos, m_pos + 20, value).ptr; // 20 = UINT64_MAX
+        return *this;
+    }
+
+    size_t size() const { return static_cast<size_t>(m_pos - m_begin); }
+
+private:
+    char* m_begin;
+    char* m_pos;
+};
+
+// Pulls whitespace-separated ints out of a string_view
+class TextReader {
+public:
+    explicit TextReader(std::string_view text) : m_text(text), m_pos(0) { }
+
+    // Reads the next field. MissingField at the end of input, BadField if it is not an int
+    CodecError field(int& value) {
+        skipSpace();
+        if (m_pos == m_text.size())
+            return CodecError::MissingField;
+
+        // istream accepted an explicit plus sign, from_chars does not
+        const char* first = m_text.data() + m_pos;
+        const char* last = m_text.data() + m_text.size();
+        if (*first == '+' && first + 1 != last && *(first + 1) != '-')
+            ++first;
+
+        auto result = std::from_chars(first, last, value);
+        if (result.ec != std::errc() || (result.ptr != last && !isSpace(*result.ptr)))
+            return CodecError::BadField;
+
+        m_pos = static_cast<size_t>(result.ptr - m_text.data());
+        return CodecError::None;
+    }
+
+    // Reads a "key=value" trailer with an unsigned value
+    CodecError tag(char& key, uint64_t& value) {
+        skipSpace();
+        if (m_text.size() - m_pos < 3 || m_text[m_pos + 1] != '=')
+            return CodecError::TrailingData;
+
+        const char* first = m_text.data() + m_pos + 2;
+        const char* last = m_text.data() + m_text.size();
+        auto result = std::from_chars(first, last, value);
+        if (result.ec != std::errc() || (result.ptr != last && !isSpace(*result.ptr)))
+            return CodecError::BadField;
+
+        key = m_text[m_pos];
+        m_pos = static_cast<size_t>(result.ptr - m_text.data());
+        return CodecError::None;
+    }
+
+    // Offset of the next field, skipping whitespace
+    size_t next() {
+        skipSpace();
+        return m_pos;
+    }
+
+    // True if only whitespace is left
+    bool atEnd() {
+        skipSpace();
+        return m_pos == m_text.size();
+    }
+
+    size_t position() const { return m_pos; }
+
+private:
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    void skipSpace() {
+        while (m_pos < m_text.size() && isSpace(m_text[m_pos]))
+            ++m_pos;
+    }
+
+    std::string_view m_text;
+    size_t m_pos;
+};
+
+// Write the fields of a message into a buffer of at least TEXT_CODEC_MAX_SIZE
+static size_t encodeFields(const Message& message, char* out) {
+    TextWriter writer(out);
+    writer.field(message.isHighPriority()).field(static_cast<int>(message.getFormat()));
+
+    std::visit([&writer](auto&& payload) {
+        using T = std::decay_t<decltype(payload)>;
+
+        if constexpr (std::is_same_v<T, Generic>) {
+            writer.field(payload.value);
+        } else if constexpr (std::is_same_v<T, WheelMessage>) {
+            writer.field(payload.velocity).field(payload.theta).field(payload.angle_velocity);
+        } else if constexpr (std::is_same_v<T, ArmMessage>) {
+            writer.field(payload.armXPos).field(payload.armYPos).field(payload.armZPos)
+                  .field(payload.clawXPos).field(payload.clawYPos).field(payload.clawOpen)
+                  .field(payload.clawRotation).field(payload.wristRotation);
+        } else if constexpr (std::is_same_v<T, ScienceToolMessage>) {
+            writer.field(payload.moveUpDown).field(payload.moveLeftRight)
+                  .field(payload.xPos).field(payload.yPos);
+        }
+    }, message.getPayload());
+
+    // Optional trailers, only present when set so untraced output is unchanged
+    if (message.traceId() != 0)
+        writer.tag('t', message.traceId());
+    if (message.sequence() != 0)
+        writer.tag('s', message.sequence());
+
+    return writer.size();
+}
+
+/*
+ * Encode straight into the caller's buffer when it is big enough for any
+ * message, otherwise through a stack buffer so the result can be truncated
+ */
+size_t TextCodec::encode(const Message& message, char* out, size_t capacity) {
+    if (capacity >= TEXT_CODEC_MAX_SIZE)
+        return encodeFields(message, out);
+
+    char scratch[TEXT_CODEC_MAX_SIZE];
+    size_t size = encodeFields(message, scratch);
+    memcpy(out, scratch, size < capacity ? size : capacity);
+    return size;
+}
+
+/*
+ * Parse the header, then exactly the fields the format requires
+ */
+DecodeResult TextCodec::decode(std::string_view text, Message& message) {
+    TextReader reader(text);
+    DecodeResult result;
+
+    // Record where the first problem was found. Fields that parse but hold a
+    // bad value are reported at their start
+    auto fail = [&result, &reader](CodecError error, size_t position = SIZE_MAX) {
+        result.error = error;
+        result.position = (position == SIZE_MAX) ? reader.position() : position;
+        return result;
+    };
+
+    if (reader.atEnd())
+        return fail(CodecError::Empty);
+
+    int priority;
+    size_t start = reader.next();
+    if (reader.field(priority) != CodecError::None || (priority != 0 && priority != 1))
+        return fail(CodecError::BadPriority, start);
+
+    int format;
+    start = reader.next();
+    CodecError error = reader.field(format);
+    if (error != CodecError::None)
+        return fail(error == CodecError::MissingField ? error : CodecError::BadFormat);
+
+    // Read the given fields in order, stopping at the first error
+    auto readFields = [&reader](auto&... values) {
+        CodecError status = CodecError::None;
+        ((status = (status == CodecError::None ? reader.field(values) : status)), ...);
+        return status;
+    };
+
+    MessagePayload payload;
+    switch (format) {
+        case MESSAGE_FORMAT_GENERIC: {
+            Generic g;
+            error = readFields(g.value);
+            payload = g;
+            break;
+        }
+        case MESSAGE_FORMAT_WHEEL: {
+            WheelMessage wm;
+            error = readFields(wm.velocity, wm.theta, wm.angle_velocity);
+            payload = wm;
+            break;
+        }
+        case MESSAGE_FORMAT_ARM: {
+            ArmMessage am;
+            error = readFields(am.armXPos, am.armYPos, am.armZPos,
+                               am.clawXPos, am.clawYPos, am.clawOpen,
+                               am.clawRotation, am.wristRotation);
+            payload = am;
+            break;
+        }
+        case MESSAGE_FORMAT_SCIENCE_TOOL: {
+            ScienceToolMessage stm;
+            error = readFields(stm.moveUpDown, stm.moveLeftRight, stm.xPos, stm.yPos);
+            payload = stm;
+            break;
+        }
+        default:
+            return fail(CodecError::BadFormat, start);
+    }
+    if (error != CodecError::None)
+        return fail(error);
+
+    // Optional "key=value" trailers: t = trace id, s = sequence
+    uint64_t traceId = 0;
+    uint64_t sequence = 0;
+    while (!reader.atEnd()) {
+        char key;
+        uint64_t value;
+        start = reader.next();
+        error = reader.tag(key, value);
+        if (error != CodecError::None)
+            return fail(error);
+
+        if (key == 't')
+            traceId = value;
+        else if (key == 's')
+            sequence = value;
+        else
+            return fail(CodecError::TrailingData, start);
+    }
+
+    message = Message(priority, payload);
+    message.setTraceId(traceId);
+    message.setSequence(sequence);
+    result.position = reader.position();
+    return result;
+}
+
+/*
+ * Returns a readable name for an error
+ */
+const char* TextCodec::errorString(CodecError error) {
+    switch (error) {
+        case CodecError::None:         return "no error";
+        case CodecError::Empty:        return "empty message";
+        case CodecError::BadPriority:  return "invalid priority";
+        case CodecError::BadFormat:    return "unknown message format";
+        case CodecError::BadField:     return "invalid field";
+        case CodecError::MissingField: return "missing field";
+        case CodecError::TrailingData: return "unexpected trailing data";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,82 @@
+#ifndef TEXT_CODEC_H
+#define TEXT_CODEC_H
+
+#include "Message.h"
+#include <stddef.h>
+#include <string_view>
+
+#pragma once
+
+#define TEXT_CODEC_MAX_SIZE 160 // Upper bound on an encoded message (8 ints, header and trailers)
+
+// Why a text message could not be decoded
+enum class CodecError {
+    None,
+    Empty,          // No fields at all
+    BadPriority,    // Priority is not 0 or 1
+    BadFormat,      // Format is not a known MessageFormat
+    BadField,       // A field is not a valid int (or out of range)
+    MissingField,   // Fewer fields than the format requires
+    TrailingData,   // More fields than the format requires, or an unknown trailer
+};
+
+// Outcome of TextCodec::decode
+struct DecodeResult {
+    CodecError error = CodecError::None;
+    size_t position = 0;   // Byte offset where decoding stopped (the bad field on error)
+
+    explicit operator bool() const { return error == CodecError::None; }
+};
+
+// Space-separated text format used on the wire:
+//   <priority> <format> <field> <field> ... [t=<trace id>] [s=<sequence>]
+// e.g. "1 0 120 45 10" for a high priority WheelMessage. The trailing
+// key=value tags are only written when set (a traced message carries
+// " t=<id>", a message sent in dual-stream mode " s=<sequence>"), so plain
+// messages are unchanged for legacy tooling. The server only sends a trace
+// id to clients that asked for it with "trace=1" in the handshake query;
+// everyone else receives sampled messages byte-identical to unsampled ones.
+//
+// Uses std::to_chars/std::from_chars directly on caller memory, so it is
+// locale-independent and never allocates. The output is byte-identical to the
+// previous iostream encoder, and the decoder accepts the same input (fields
+// separated by any whitespace) but rejects malformed messages instead of
+// leaving fields uninitialized.
+class TextCodec {
+public:
+    /** Encodes a message into a caller-provided buffer
+     *
+     * @param
+     *  message: const Message& - The message to encode
+     *  out: char* - Destination buffer
+     *  capacity: size_t - Size of the destination buffer
+     *
+     * @return
+     *  size_t - Length of the encoded message. If larger than capacity the
+     *           output was truncated and a bigger buffer is needed
+     */
+    static size_t encode(const Message& message, char* out, size_t capacity);
+
+    /** Decodes a message, validating every field
+     *
+     * @param
+     *  text: std::string_view - The encoded message
+     *  message: Message& - Receives the message (unchanged on error)
+     *
+     * @return
+     *  DecodeResult - The error (None on success) and where it happened
+     */
+    static DecodeResult decode(std::string_view text, Message& message);
+
+    /** Returns a readable name for an error
+     *
+     * @param
+     *  error: CodecError - The error to describe
+     *
+     * @return
+     *  const char* - Static description of the error
+     */
+    static const char* errorString(CodecError error);
+};
+
+#endif
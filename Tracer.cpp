@@ -0,0 +1,176 @@
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+static_assert((TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) == 0,
+              "TRACE_BUFFER_SIZE must be a power of two");
+
+// Threads are numbered in the order they first record, for the "tid" field
+static uint32_t threadNumber() {
+    static std::atomic<uint32_t> next { 1 };
+    thread_local uint32_t number = next.fetch_add(1, std::memory_order_relaxed);
+    return number;
+}
+
+// Constructor
+Tracer::Tracer() { }
+
+// The tracer lives for the whole process; never destroyed, so threads still
+// recording during static destruction stay safe
+Tracer& Tracer::instance() {
+    static Tracer* tracer = new Tracer();
+    return *tracer;
+}
+
+// Change the sampling interval, allocating the ring on first use
+void Tracer::setSampling(uint32_t every) {
+    if (every != 0) {
+        std::call_once(m_allocated, [this]() {
+            m_slots.store(new Slot[TRACE_BUFFER_SIZE], std::memory_order_release);
+        });
+    }
+    m_every.store(every, std::memory_order_relaxed);
+}
+
+/*
+ * Sample on push, then record it. Each producer thread counts down its own
+ * pushes, so producers share no counter and only sampled pushes touch a
+ * shared atomic (for the id)
+ */
+void Tracer::onPush(Message& message) {
+    uint32_t every = m_every.load(std::memory_order_relaxed);
+    if (every == 0)
+        return;
+
+    if (message.traceId() == 0) {
+        thread_local uint32_t countdown = 0;
+        if (countdown >= every)
+            countdown = 0;   // The interval was shortened since this thread last pushed
+        if (countdown != 0) {
+            --countdown;
+            return;
+        }
+        countdown = every - 1;
+        message.setTraceId(m_nextId.fetch_add(1, std::memory_order_relaxed));
+    }
+    record(message.traceId(), TraceStage::Push);
+}
+
+// Claim the next slot and fill it
+void Tracer::record(uint64_t traceId, TraceStage stage, int64_t timeNs) {
+    Slot* slots = m_slots.load(std::memory_order_acquire);
+    if (traceId == 0 || slots == nullptr)
+        return;
+
+    uint64_t index = m_head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[index & (TRACE_BUFFER_SIZE - 1)];
+
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.traceId.store(traceId, std::memory_order_relaxed);
+    slot.timeNs.store(timeNs, std::memory_order_relaxed);
+    slot.stage.store(static_cast<uint32_t>(stage), std::memory_order_relaxed);
+    slot.thread.store(threadNumber(), std::memory_order_relaxed);
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+}
+
+// Copy out every complete event, then emit one slice per pair of consecutive stages
+size_t Tracer::dump(std::ostream& out) const {
+    struct Event {
+        uint64_t traceId;
+        int64_t timeNs;
+        uint32_t stage;
+        uint32_t thread;
+    };
+
+    Slot* slots = m_slots.load(std::memory_order_acquire);
+    std::vector<Event> events;
+    for (size_t i = 0; slots != nullptr && i < TRACE_BUFFER_SIZE; ++i) {
+        const Slot& slot = slots[i];
+        uint64_t before = slot.seq.load(std::memory_order_acquire);
+        if (before == 0 || (before & 1))
+            continue;
+
+        Event event { slot.traceId.load(std::memory_order_relaxed),
+                      slot.timeNs.load(std::memory_order_relaxed),
+                      slot.stage.load(std::memory_order_relaxed),
+                      slot.thread.load(std::memory_order_relaxed) };
+
+        // Skip slots rewritten while they were being copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == before)
+            events.push_back(event);
+    }
+
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+        return a.traceId != b.traceId ? a.traceId < b.traceId
+             : a.timeNs != b.timeNs ? a.timeNs < b.timeNs
+             : a.stage < b.stage;
+    });
+
+    // Async begin/end pairs keyed by trace id give each message its own track
+    char line[256];
+    bool first = true;
+    auto slice = [&](const char* name, const Event& from, const Event& to) {
+        for (int end = 0; end < 2; ++end) {
+            const Event& event = end ? to : from;
+            snprintf(line, sizeof line,
+                     "%s{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"%c\",\"id\":\"0x%llx\","
+                     "\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                     first ? "\n" : ",\n", name, end ? 'e' : 'b',
+                     static_cast<unsigned long long>(event.traceId),
+                     event.timeNs / 1000.0, event.thread);
+            out << line;
+            first = false;
+        }
+    };
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    size_t start = 0;
+    while (start < events.size()) {
+        size_t end = start;
+        while (end + 1 < events.size() && events[end + 1].traceId == events[start].traceId)
+            ++end;
+
+        // Whole message, then each hop nested inside it
+        slice("message", events[start], events[end]);
+        for (size_t i = start; i < end; ++i) {
+            std::string name = std::string(stageName(static_cast<TraceStage>(events[i].stage)))
+                + " -> " + stageName(static_cast<TraceStage>(events[i + 1].stage));
+            slice(name.c_str(), events[i], events[i + 1]);
+        }
+        start = end + 1;
+    }
+    out << "\n]}\n";
+
+    return events.size();
+}
+
+// Forget everything recorded so far
+void Tracer::clear() {
+    Slot* slots = m_slots.load(std::memory_order_acquire);
+    for (size_t i = 0; slots != nullptr && i < TRACE_BUFFER_SIZE; ++i)
+        slots[i].seq.store(0, std::memory_order_relaxed);
+}
+
+// Steady clock in nanoseconds
+int64_t Tracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Name of a stage as shown in the trace
+const char* Tracer::stageName(TraceStage stage) {
+    switch (stage) {
+        case TraceStage::Push:          return "push";
+        case TraceStage::Pop:           return "pop";
+        case TraceStage::Encode:        return "encode";
+        case TraceStage::WriteComplete: return "write";
+        case TraceStage::Receive:       return "receive";
+        case TraceStage::Decode:        return "decode";
+        case TraceStage::Dispatch:      return "dispatch";
+    }
+    return "unknown";
+}
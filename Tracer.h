@@ -0,0 +1,160 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "Message.h"
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+
+#pragma once
+
+#define TRACE_BUFFER_SIZE 65536 // Events kept in the trace ring (power of two, oldest overwritten)
+
+// Points in a message's life that are timestamped when it is traced
+enum class TraceStage : uint32_t {
+    Push,           // Accepted by a queue
+    Pop,            // Taken off a queue by a session
+    Encode,         // Serialized (once per message, skipped if already cached)
+    WriteComplete,  // Write to the socket finished on the server
+    Receive,        // Frame read off the socket by the client
+    Decode,         // Parsed by the client
+    Dispatch,       // Handed to the client application by receive()/tryReceive(), before decoding
+};
+
+// Process-wide, opt-in message tracer.
+//
+// A sampled message gets a trace id when it is first pushed. The id travels
+// with the message (and over the wire as a " t=<id>" trailer, to clients that
+// connected while tracing was on and so asked for it), and every stage
+// it passes through records a timestamped event into a fixed-size lock-free
+// ring. Untraced messages cost a branch per stage (and a relaxed load and a
+// per-thread countdown per push while sampling is on). The ring can be
+// dumped at any time as Chrome Trace Event JSON, viewable in chrome://tracing
+// or Perfetto, where each message shows up as its own track.
+//
+// Example Usage:
+//   Tracer::instance().setSampling(100);   // Trace 1 in 100 messages
+// Processes that only receive (clients) turn recording on the same way,
+// before connecting.
+//   ...
+//   std::ofstream out("trace.json");
+//   Tracer::instance().dump(out);
+class Tracer {
+public:
+    /** Returns the process-wide tracer
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  Tracer& - The tracer
+     */
+    static Tracer& instance();
+
+    /** Sets how many pushed messages are traced. The event ring is allocated
+     * the first time tracing is turned on; until then nothing is recorded
+     *
+     * @param
+     *  every: uint32_t - Trace one message in every `every` pushed by each
+     *                   thread (0 = off, 1 = all)
+     *
+     * @return
+     *  none
+     */
+    void setSampling(uint32_t every);
+
+    /** Returns if tracing is on
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  bool - True if messages are being sampled
+     */
+    bool enabled() const { return m_every.load(std::memory_order_relaxed) != 0; }
+
+    /** Gives a pushed message a trace id if it is sampled, and records the push.
+     * Messages that already carry an id keep it
+     *
+     * @param
+     *  message: Message& - The message being pushed
+     *
+     * @return
+     *  none
+     */
+    void onPush(Message& message);
+
+    /** Records a stage for a traced message (does nothing for trace id 0)
+     *
+     * @param
+     *  traceId: uint64_t - The message's trace id
+     *  stage: TraceStage - The stage reached
+     *  timeNs: int64_t - When it was reached (now if omitted)
+     *
+     * @return
+     *  none
+     */
+    void record(uint64_t traceId, TraceStage stage, int64_t timeNs);
+    void record(uint64_t traceId, TraceStage stage) {
+        if (traceId != 0)
+            record(traceId, stage, now());
+    }
+
+    /** Writes the buffered events as Chrome Trace Event JSON. Consecutive
+     * stages of each message become one slice on that message's track
+     *
+     * @param
+     *  out: std::ostream& - Destination for the JSON
+     *
+     * @return
+     *  size_t - Number of events written
+     */
+    size_t dump(std::ostream& out) const;
+
+    /** Discards all buffered events
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  none
+     */
+    void clear();
+
+    /** Returns the trace clock (steady_clock nanoseconds, shared by all
+     * processes on a host)
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  int64_t - Current time in nanoseconds
+     */
+    static int64_t now();
+
+    // Short name of a stage as shown in the trace
+    static const char* stageName(TraceStage stage);
+
+private:
+    Tracer();
+
+    // One event. Fields are atomics so the dump can read them while writers
+    // run; seq is odd while a writer is filling the slot
+    struct Slot {
+        std::atomic<uint64_t> seq { 0 };
+        std::atomic<uint64_t> traceId { 0 };
+        std::atomic<int64_t> timeNs { 0 };
+        std::atomic<uint32_t> stage { 0 };
+        std::atomic<uint32_t> thread { 0 };
+    };
+
+    std::atomic<uint32_t> m_every { 0 };      // Sampling interval (0 = off)
+    std::atomic<uint64_t> m_nextId { 1 };     // Next trace id
+    std::atomic<uint64_t> m_head { 0 };       // Events ever recorded
+    std::atomic<Slot*> m_slots { nullptr };   // Event ring (null until first enabled)
+    std::once_flag m_allocated;
+};
+
+#endif
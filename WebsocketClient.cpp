@@ -1,39 +1,242 @@
 #include "WebsocketClient.h"
+#include "Tracer.h"
+#include <future>
+#include <stdexcept>
 
 using namespace boost;
 using tcp = asio::ip::tcp;
 namespace websocket = beast::websocket;
 
 // Constructor
-WebSocketClient::WebSocketClient(const std::string& host, const std::string& port)
-    : host(host), port(port), ws(ioc) {}
+WebSocketClient::WebSocketClient(const std::string& host, const std::string& port,
+                                 const std::string& target, HeartbeatConfig heartbeat)
+    : host(host), port(port), target(target), ws(ioc), work(ioc.get_executor()), timer(ioc), heartbeat(heartbeat),
+      arena(CLIENT_INBOX_LIMIT + 1) {}
+
+// Destructor
+WebSocketClient::~WebSocketClient() {
+    if (runner.joinable()) {
+        asio::post(ioc, [this]() { fail("client destroyed"); });
+        work.reset();
+        runner.join();
+    }
+}
 
 // Connect to the WebSocket server
 void WebSocketClient::connect() {
     tcp::resolver resolver(ioc);
     auto const results = resolver.resolve(host, port);
     asio::connect(ws.next_layer(), results.begin(), results.end());
-    ws.handshake(host, "/");
+
+    // Small control frames (pings/pongs) must not be held back by Nagle's algorithm
+    ws.next_layer().set_option(tcp::no_delay(true));
+
+    // While tracing, ask for the trace ids of sampled messages; otherwise
+    // the server sends them as plain messages
+    std::string request = target;
+    if (Tracer::instance().enabled())
+        request += (request.find('?') == std::string::npos ? "?" : "&") + std::string("trace=1");
+    ws.handshake(host, request);
+
+    // Pongs (and pings answered by beast) arrive through the read loop
+    ws.control_callback([this](websocket::frame_type kind, beast::string_view payload) {
+        if (kind == websocket::frame_type::pong)
+            heartbeat.onPong(payload, Heartbeat::Clock::now());
+        else
+            heartbeat.onActivity(Heartbeat::Clock::now());
+    });
+
+    reading = true;
+    read();
+    tick();
+    runner = std::thread([this]() { ioc.run(); });
 }
 
 // Send a message to the WebSocket server
 void WebSocketClient::send(const std::string& message) {
-    ws.write(asio::buffer(message));
+    std::promise<beast::error_code> done;
+    auto result = done.get_future();
+
+    asio::post(ioc, [this, &message, &done]() {
+        ws.async_write(asio::buffer(message), [&done](beast::error_code ec, std::size_t) {
+            done.set_value(ec);
+        });
+    });
+
+    beast::error_code ec = result.get();
+    if (ec)
+        throw beast::system_error(ec);
 }
 
 // Receive a serialized Message from the WebSocket server
 Message WebSocketClient::receive() {
-    beast::flat_buffer buffer;
-    ws.read(buffer);
-    std::string received = beast::buffers_to_string(buffer.data());
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this]() { return !inbox.empty() || dead; });
+
+    if (inbox.empty())
+        throw std::runtime_error("WebSocket connection lost: " + reason);
+
+    return take(lock);
+}
+
+// Receive a serialized Message from the WebSocket server without waiting
+bool WebSocketClient::tryReceive(Message& message) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (inbox.empty()) {
+        if (dead)
+            throw std::runtime_error("WebSocket connection lost: " + reason);
+        return false;
+    }
+
+    message = take(lock);
+    return true;
+}
+
+// Set the arrival/loss callback
+void WebSocketClient::onReady(std::function<void()> callback) {
+    ready = std::move(callback);
+}
+
+// Pop the front of the inbox, then decode it outside the lock
+Message WebSocketClient::take(std::unique_lock<std::mutex>& lock) {
+    Received received = inbox.pop_front();
+
+    // The application has the message from here; decoding runs on its thread
+    int64_t dispatchedNs = received.receivedNs != 0 ? Tracer::now() : 0;
+
+    // Resume reading if the inbox had filled up
+    if (!reading && !dead) {
+        reading = true;
+        asio::post(ioc, [this]() { read(); });
+    }
+    lock.unlock();
 
     // Deserialize the Message object
-    Message msg = Message::deserialize(received);
+    Message msg = Message::deserialize(received.bytes.data(), received.bytes.size());
+
+    // Traced messages carry their id, so the earlier stages are recorded after decoding
+    if (msg.traceId() != 0) {
+        Tracer& tracer = Tracer::instance();
+        tracer.record(msg.traceId(), TraceStage::Receive, received.receivedNs);
+        tracer.record(msg.traceId(), TraceStage::Dispatch, dispatchedNs);
+        tracer.record(msg.traceId(), TraceStage::Decode);
+    }
 
     return msg;
 }
 
 // Close the WebSocket connection
 void WebSocketClient::close() {
-    ws.close(websocket::close_code::normal);
-}
\ No newline at end of file
+    if (!runner.joinable())
+        return;
+
+    std::promise<void> done;
+    auto result = done.get_future();
+
+    asio::post(ioc, [this, &done]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (dead) {
+            done.set_value();
+            return;
+        }
+        lock.unlock();
+
+        timer.cancel();
+        ws.async_close(websocket::close_code::normal, [this, &done](beast::error_code ec) {
+            fail(ec ? ec.message() : "closed");
+            done.set_value();
+        });
+    });
+
+    result.get();
+    work.reset();
+    runner.join();
+}
+
+// Smoothed RTT to the server
+std::chrono::microseconds WebSocketClient::rtt() const { return heartbeat.rtt(); }
+
+// Allocation counters of the inbox storage
+BufferPool::Stats WebSocketClient::bufferStats() { return arena.stats(); }
+
+// Read the next message into the inbox, pausing while the inbox is full
+void WebSocketClient::read() {
+    ws.async_read(readBuffer, [this](beast::error_code ec, std::size_t) {
+        if (ec)
+            return fail(ec.message());
+
+        heartbeat.onActivity(Heartbeat::Clock::now());
+
+        // Copy the frame into an arena block so the read buffer can be reused
+        Received received;
+        if (Tracer::instance().enabled())
+            received.receivedNs = Tracer::now();
+
+        received.bytes = arena.acquire(readBuffer.size());
+        received.bytes.resize(asio::buffer_copy(
+            asio::buffer(received.bytes.data(), received.bytes.capacity()), readBuffer.data()));
+        readBuffer.consume(readBuffer.size());
+
+        std::unique_lock<std::mutex> lock(mutex);
+        inbox.push_back(std::move(received));
+        cond.notify_one();
+
+        bool full = inbox.full();
+        if (full)
+            reading = false;
+        lock.unlock();
+
+        if (ready)
+            ready();
+        if (!full)
+            read();
+    });
+}
+
+// Periodically send pings and check for a dead link
+void WebSocketClient::tick() {
+    timer.expires_after(heartbeat.checkInterval());
+    timer.async_wait([this](beast::error_code ec) {
+        if (ec)
+            return;
+
+        auto now = Heartbeat::Clock::now();
+
+        // Pongs cannot be seen while reading is paused on a full inbox; that
+        // is a slow consumer, not a dead link
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!reading)
+            heartbeat.onActivity(now);
+        lock.unlock();
+
+        if (heartbeat.expired(now))
+            return fail("heartbeat timeout");
+
+        if (heartbeat.shouldPing(now)) {
+            ws.async_ping(heartbeat.ping(now), [this](beast::error_code ec) {
+                if (ec)
+                    fail(ec.message());
+            });
+        }
+        tick();
+    });
+}
+
+// Mark the connection dead and abort outstanding operations
+void WebSocketClient::fail(const std::string& why) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (dead)
+        return;
+    dead = true;
+    reason = why;
+    cond.notify_all();
+    lock.unlock();
+
+    if (ready)
+        ready();
+
+    beast::error_code ignored;
+    timer.cancel();
+    ws.next_layer().shutdown(tcp::socket::shutdown_both, ignored);
+    ws.next_layer().close(ignored);
+}
@@ -3,8 +3,17 @@
 #include <boost/beast/websocket.hpp>
 #include <boost/asio.hpp>
 #include <boost/beast/core.hpp>
-#include "Message.h" 
+#include "Message.h"
+#include "Heartbeat.h"
+#include "BufferPool.h"
+#include "RingBuffer.h"
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <thread>
+
+#define CLIENT_INBOX_LIMIT 100 // Received messages buffered before reading pauses
 
 
 class WebSocketClient {
@@ -15,13 +24,23 @@ public:
      * @param
      *  host: const std::string& - The server host address (e.g., "127.0.0.1")
      *  port: const std::string& - The server port (e.g., "8080")
+     *  target: const std::string& - The channel to join (e.g., "/wheel", default "/")
+     *  heartbeat: HeartbeatConfig - Ping interval and dead-link timeout
      *
      * Example Usage:
      *   WebSocketClient client("127.0.0.1", "8080");
+     *   WebSocketClient wheels("127.0.0.1", "8080", "/wheel");
      */
-    WebSocketClient(const std::string& host, const std::string& port);
+    WebSocketClient(const std::string& host, const std::string& port,
+                    const std::string& target = "/",
+                    HeartbeatConfig heartbeat = HeartbeatConfig());
+
+    // Destructor
+    ~WebSocketClient();
 
-    /** Connects to the WebSocket server
+    /** Connects to the WebSocket server and starts the background IO thread
+     * that receives messages and answers/sends heartbeats. If Tracer is on,
+     * the handshake asks for the trace ids of sampled messages ("trace=1")
      *
      * @param
      *  none
@@ -48,9 +67,37 @@ public:
      *
      * @return
      *  Message - The received message as a Message object
+     *
+     * Throws std::runtime_error once the connection is closed or the heartbeat
+     * times out and no received messages remain.
      */
     Message receive();
 
+    /** Receives a message from the server if one is already waiting
+     *
+     * @param
+     *  message: Message& - Receives the message
+     *
+     * @return
+     *  bool - True if a message was returned, False if none has arrived yet
+     *
+     * Throws std::runtime_error once the connection is closed or the heartbeat
+     * times out and no received messages remain.
+     */
+    bool tryReceive(Message& message);
+
+    /** Sets a callback run on the IO thread whenever a message arrives or the
+     * connection is lost, for waiting on several clients at once. Set it
+     * before connect(); it must not call back into this client
+     *
+     * @param
+     *  callback: std::function<void()> - Called when receive() may not block
+     *
+     * @return
+     *  none
+     */
+    void onReady(std::function<void()> callback);
+
     /** Closes the WebSocket connection
      *
      * @param
@@ -61,9 +108,57 @@ public:
      */
     void close();
 
+    /** Returns the smoothed round trip time to the server
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  std::chrono::microseconds - The smoothed RTT, or -1 before the first pong
+     */
+    std::chrono::microseconds rtt() const;
+
+    /** Returns the allocation counters of the receive buffers
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  BufferPool::Stats - The counters of the client's arena
+     */
+    BufferPool::Stats bufferStats();
+
 private:
+    // A frame waiting in the inbox
+    struct Received {
+        PooledBuffer bytes;
+        int64_t receivedNs = 0;           // Read completion time, when tracing
+    };
+
+    void read();                          // Issue the next async read
+    void tick();                          // Heartbeat timer
+    void fail(const std::string& why);    // Mark the link dead (IO thread only)
+
+    // Take the front of the inbox and decode it (called with the lock held; releases it)
+    Message take(std::unique_lock<std::mutex>& lock);
+
     std::string host;
     std::string port;
+    std::string target;                   // Handshake path selecting the server channel
     boost::asio::io_context ioc; // Boost ASIO IO context
     boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws; // WebSocket stream
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work; // Keeps ioc running until close
+    boost::asio::steady_timer timer;      // Drives the heartbeat
+    boost::beast::flat_buffer readBuffer; // Buffer for the in-flight read (grows once, then reused)
+    Heartbeat heartbeat;                  // Ping/pong state and RTT estimate
+    BufferPool arena;                     // Storage for inbox entries
+    std::function<void()> ready;          // Called on arrival and loss (IO thread)
+    std::thread runner;                   // Runs ioc
+
+    std::mutex mutex;                     // Guards the fields below
+    std::condition_variable cond;
+    RingBuffer<Received, CLIENT_INBOX_LIMIT> inbox; // Received, not yet deserialized messages
+    bool reading = false;                 // A read is outstanding
+    bool dead = false;                    // The connection is gone
+    std::string reason;                   // Why the connection is gone
 };
@@ -1,50 +1,464 @@
 #include "WebsocketServer.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <condition_variable>
+
+#if defined(__linux__)
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+#endif
 
 
 using namespace boost;
 using tcp = asio::ip::tcp;
 namespace websocket = beast::websocket;
+namespace http = beast::http;
+
+// What a session carries. Single sessions take the whole queue; the two
+// halves of a dual-stream client split it by priority
+enum class StreamKind { Single, Priority, Regular };
+
+// State of one client connection. Reads, pings and writes run asynchronously
+// on the session's own io_context (driven by `runner`), while the session
+// thread pops messages and hands them over one write at a time.
+struct WebSocketServer::Session {
+    Session(uint64_t id, HeartbeatConfig config, FlowControlConfig flowConfig) :
+        id(id), ws(ioc), timer(ioc), heartbeat(config), flow(flowConfig) {}
+
+    // Start the read loop, the heartbeat timer and the IO thread
+    void start() {
+        ws.control_callback([this](websocket::frame_type kind, beast::string_view payload) {
+            if (kind == websocket::frame_type::pong)
+                heartbeat.onPong(payload, Heartbeat::Clock::now());
+            else
+                heartbeat.onActivity(Heartbeat::Clock::now());
+        });
+        read();
+        tick();
+        runner = std::thread([this]() { ioc.run(); });
+    }
+
+    // Keep a read outstanding so control frames (pongs) are processed
+    void read() {
+        ws.async_read(readBuffer, [this](beast::error_code ec, std::size_t) {
+            if (ec)
+                return fail(ec.message());
+            heartbeat.onActivity(Heartbeat::Clock::now());
+            readBuffer.consume(readBuffer.size());
+            read();
+        });
+    }
+
+    // Periodically send pings and check for a dead link
+    void tick() {
+        timer.expires_after(heartbeat.checkInterval());
+        timer.async_wait([this](beast::error_code ec) {
+            if (ec)
+                return;
+
+            auto now = Heartbeat::Clock::now();
+            if (heartbeat.expired(now))
+                return fail("heartbeat timeout");
+
+            // Notice the socket draining (or not) between writes
+            flow.onPendingBytes(pendingBytes());
+
+            if (heartbeat.shouldPing(now)) {
+                ws.async_ping(heartbeat.ping(now), [this](beast::error_code ec) {
+                    if (ec)
+                        fail(ec.message());
+                });
+            }
+            tick();
+        });
+    }
+
+    enum class WriteState { Ready, Busy, Dead };
+
+    // Wait up to timeout for the previous write to finish
+    WriteState waitReady(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, timeout, [this]() { return !writing || dead; });
+        if (dead)
+            return WriteState::Dead;
+        return writing ? WriteState::Busy : WriteState::Ready;
+    }
+
+    // Time since the outstanding write was handed to the IO thread
+    FlowControl::Clock::duration writeInFlight() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return FlowControl::Clock::now() - writeStarted;
+    }
+
+    // Hand a message's encoded bytes to the IO thread. Returns false if the link is dead
+    bool send(const Message& message) {
+        uint64_t traceId = message.traceId();
+        EncodedBuffer data;
+
+        // Clients that did not ask for trace ids get the bytes of an untraced
+        // message; the server still records the id's stages
+        if (traceId != 0 && !traceIds) {
+            Message plain(message);
+            plain.setTraceId(0);
+            data = plain.encoded();
+            Tracer::instance().record(traceId, TraceStage::Encode);
+        } else {
+            data = message.encoded();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (dead)
+            return false;
+        writing = true;
+        writeStarted = FlowControl::Clock::now();
+        writeBuffer = std::move(data);
+        writeMessage = message;
+
+        asio::post(ioc, StartWrite { this, traceId });
+        return true;
+    }
+
+    // Posted by send(). Posting from the session thread cannot use the IO
+    // thread's handler cache, so the operation is allocated from the
+    // session's pool rather than the heap
+    struct StartWrite {
+        using allocator_type = PoolAllocator<void>;
+
+        Session* session;
+        uint64_t traceId;
+
+        allocator_type get_allocator() const { return allocator_type(session->arena); }
+        void operator()() const { session->write(traceId); }
+    };
+
+    // Write the buffer handed over by send() (IO thread only)
+    void write(uint64_t traceId) {
+        auto started = FlowControl::Clock::now();
+        ws.text(true);
+        ws.async_write(asio::buffer(writeBuffer->data(), writeBuffer->size()), [this, started, traceId](beast::error_code ec, std::size_t) {
+            if (!ec) {
+                flow.onWriteComplete(FlowControl::Clock::now() - started, pendingBytes());
+                Tracer::instance().record(traceId, TraceStage::WriteComplete);
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            writing = false;
+            writeBuffer.reset();
+            writeFailed = static_cast<bool>(ec);
+            if (!writeFailed)
+                writeMessage = Message();
+            cond.notify_all();
+            lock.unlock();
+            if (ec)
+                fail(ec.message());
+        });
+    }
+
+    // The message whose write failed, if the last write did not complete
+    bool takeFailedWrite(Message& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!writeFailed)
+            return false;
+        writeFailed = false;
+        message = writeMessage;
+        return true;
+    }
+
+    // Bytes written to the socket that the peer has not yet received (IO thread only)
+    size_t pendingBytes() {
+#if defined(__linux__)
+        int unsent = 0;
+        if (ioctl(ws.next_layer().native_handle(), SIOCOUTQ, &unsent) == 0 && unsent > 0)
+            return static_cast<size_t>(unsent);
+#endif
+        return 0;
+    }
+
+    // Mark the link dead and abort outstanding operations (IO thread only)
+    void fail(const std::string& why) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (dead)
+            return;
+        dead = true;
+        reason = why;
+        cond.notify_all();
+        lock.unlock();
+
+        beast::error_code ignored;
+        timer.cancel();
+        ws.next_layer().shutdown(tcp::socket::shutdown_both, ignored);
+        ws.next_layer().close(ignored);
+    }
+
+    // Tear down the IO thread
+    void stop() {
+        asio::post(ioc, [this]() { fail("session closed"); });
+        if (runner.joinable())
+            runner.join();
+    }
+
+    uint64_t id;
+    std::string remote;
+    StreamKind stream = StreamKind::Single;
+    bool traceIds = false;                // Sampled messages carry " t=<id>" ("?trace=1")
+    std::shared_ptr<BufferPool> arena;    // Encoding pool of the session thread
+    asio::io_context ioc;                 // Must outlive the stream and timer
+    websocket::stream<tcp::socket> ws;
+    asio::steady_timer timer;
+    beast::flat_buffer readBuffer;        // Grows once, then reused
+    Heartbeat heartbeat;
+    FlowControl flow;                     // Congestion tracking and conflation
+    std::thread runner;
+
+    std::mutex mutex;                     // Guards the write state below, dead and reason
+    std::condition_variable cond;
+    bool writing = false;
+    FlowControl::Clock::time_point writeStarted;
+    bool dead = false;
+    std::string reason;
+    EncodedBuffer writeBuffer;            // Kept alive by the in-flight write
+    Message writeMessage;                 // The message being written, kept until it completes
+    bool writeFailed = false;             // The last write ended with an error
+};
 
 // Constructor
-WebSocketServer::WebSocketServer(unsigned short port)
-    : acceptor(ioc, tcp::endpoint(tcp::v4(), port)) {}
+WebSocketServer::WebSocketServer(unsigned short port, bool verbose, HeartbeatConfig heartbeat,
+                                 FlowControlConfig flowControl)
+    : acceptor(ioc, tcp::endpoint(tcp::v4(), port)), verbose(verbose), heartbeat(heartbeat),
+      flowControl(flowControl) {}
 
 
-// Run the WebSocket server, sending messages from the queue
-void WebSocketServer::run(MessageQueue& queue) {
-    accept_connections(queue);
+// Register a channel with its own queue
+IMessageQueue& WebSocketServer::addChannel(const std::string& target) {
+    auto queue = std::make_unique<MessageQueue>();
+    Channel& channel = registerChannel(target, *queue);
+    channel.owned = std::move(queue);
+    return *channel.queue;
+}
+
+// Register a channel fed by the caller's queue
+void WebSocketServer::addChannel(const std::string& target, IMessageQueue& queue) {
+    registerChannel(target, queue);
+}
+
+// Add a channel to the registry, refusing duplicate targets
+WebSocketServer::Channel& WebSocketServer::registerChannel(const std::string& target, IMessageQueue& queue) {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    if (channels.count(target))
+        throw std::runtime_error("Channel already registered: " + target);
+
+    auto channel = std::make_unique<Channel>();
+    channel->target = target;
+    channel->queue = &queue;
+    return *(channels[target] = std::move(channel));
+}
+
+// Run the WebSocket server, serving every registered channel
+void WebSocketServer::run() {
+    accept_connections();
     ioc.run();
 }
 
-// Accept client WebSocket connections, passing the MessageQueue reference to each session
-void WebSocketServer::accept_connections(MessageQueue& queue) {
+// Run the WebSocket server, sending messages from the queue
+void WebSocketServer::run(IMessageQueue& queue) {
+    addChannel("/", queue);
+    run();
+}
+
+// Snapshot the live sessions, their RTT estimates and flow control state
+std::vector<WebSocketServer::SessionInfo> WebSocketServer::sessions() {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+
+    std::vector<SessionInfo> info;
+    for (auto& channel : channels) {
+        for (auto& entry : channel.second->sessions) {
+            Session& session = *entry.second;
+            const char* stream = session.stream == StreamKind::Priority ? "priority"
+                               : session.stream == StreamKind::Regular ? "regular" : "";
+            info.push_back({ entry.first, channel.first, stream, session.remote, session.heartbeat.rtt(),
+                             session.flow.congested(), session.flow.conflated(),
+                             session.flow.pendingBytes(), session.arena->stats() });
+        }
+    }
+    return info;
+}
+
+// Accept client WebSocket connections, handing each to its own session thread
+void WebSocketServer::accept_connections() {
     while(true) {
-        tcp::socket socket(ioc);
-        acceptor.accept(socket);
-        std::thread(&WebSocketServer::handle_session, this, std::move(socket), std::ref(queue)).detach();
+        std::shared_ptr<Session> session;
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            session = std::make_shared<Session>(nextSessionId++, heartbeat, flowControl);
+        }
+        acceptor.accept(session->ws.next_layer());
+        std::thread(&WebSocketServer::handle_session, this, std::move(session)).detach();
     }
 }
 
+// Read the upgrade request and look up its channel, refusing unknown targets
+WebSocketServer::Channel* WebSocketServer::route(Session& session,
+                                                 http::request<http::string_body>& request) {
+    beast::flat_buffer buffer;
+    http::read(session.ws.next_layer(), buffer, request);
+
+    // Route on the path; the query only selects the stream
+    beast::string_view target = request.target();
+    size_t question = target.find('?');
+    std::string path(target.substr(0, question));
+    std::string query(question == beast::string_view::npos ? "" : target.substr(question + 1));
+
+    // Other query parameters are ignored, as before
+    bool validStream = true;
+    std::string stream;
+    for (size_t start = 0; start < query.size(); ) {
+        size_t end = std::min(query.find('&', start), query.size());
+        if (query.compare(start, 7, "stream=") == 0)
+            stream = query.substr(start + 7, end - start - 7);
+        else if (query.compare(start, end - start, "trace=1") == 0)
+            session.traceIds = true;
+        start = end + 1;
+    }
+    if (stream == "priority")
+        session.stream = StreamKind::Priority;
+    else if (stream == "regular")
+        session.stream = StreamKind::Regular;
+    else if (!stream.empty())
+        validStream = false;
+
+    Channel* channel = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        auto it = channels.find(path);
+        if (it != channels.end())
+            channel = it->second.get();
+    }
+    if (channel && validStream && websocket::is_upgrade(request))
+        return channel;
+
+    // Plain HTTP requests get a short explanation instead of a handshake
+    http::status status = !channel ? http::status::not_found
+                        : !validStream ? http::status::bad_request
+                        : http::status::upgrade_required;
+    http::response<http::string_body> response(status, request.version());
+    response.set(http::field::content_type, "text/plain");
+    response.body() = !channel ? "Unknown channel: " + path + "\n"
+                    : !validStream ? "Unknown stream: " + stream + "\n"
+                    : "WebSocket upgrade required\n";
+    response.prepare_payload();
+    http::write(session.ws.next_layer(), response);
+
+    session.reason = !channel ? "unknown channel " + path
+                   : !validStream ? "unknown stream " + stream + " for " + path
+                   : "not a WebSocket request for " + path;
+    return nullptr;
+}
+
 // Handle a single WebSocket session with a connected client
-void WebSocketServer::handle_session(tcp::socket socket, MessageQueue& queue) {
+void WebSocketServer::handle_session(std::shared_ptr<Session> session) {
+    // Messages are encoded on this thread, into its own pool
+    session->arena = Message::encodingPool();
+
+    Channel* channel;
     try {
-        // Create a WebSocket stream from the socket and accept the connection
-        websocket::stream<tcp::socket> ws(std::move(socket));
-        ws.accept(); 
+        // Accept the WebSocket handshake before handing the stream to the IO thread
+        beast::error_code ignored;
+        auto endpoint = session->ws.next_layer().remote_endpoint(ignored);
+        session->remote = endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
 
-        while(true) {
-            // Pop the next message from the queue (blocks if empty)
-            Message msg = queue.pop();
+        // Small control frames (pings/pongs) must not be held back by Nagle's algorithm
+        session->ws.next_layer().set_option(tcp::no_delay(true));
 
-            // Serialize Message object to a string
-            std::string serializedMsg = msg.serialize();
+        // A smaller send buffer bounds how stale queued data can get on a slow link
+        if (flowControl.sendBuffer > 0) {
+            session->ws.next_layer().set_option(
+                asio::socket_base::send_buffer_size(static_cast<int>(flowControl.sendBuffer)));
+        }
 
-            // Set the message type to text and send the serialized message to the client
-            ws.text(true); 
-            ws.write(asio::buffer(serializedMsg));
-            std::cout << "Sent message" << std::endl;
+        http::request<http::string_body> request;
+        channel = route(*session, request);
+        if (!channel) {
+            std::cerr << "Session refused: " << session->reason << "\n";
+            return;
         }
+        session->ws.accept(request);
     } catch (const std::exception& e) {
         std::cerr << "Session disconnect: " << e.what() << "\n";
+        return;
     }
-}
\ No newline at end of file
+
+    IMessageQueue& queue = *channel->queue;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        channel->sessions[session->id] = session;
+    }
+    if (session->stream == StreamKind::Priority)
+        channel->prioritySessions.fetch_add(1);
+    session->start();
+
+    // Which lanes of the queue this session takes. A regular stream leaves
+    // high priority messages to the priority stream while one is connected
+    auto filter = [&]() {
+        switch (session->stream) {
+            case StreamKind::Priority: return PopFilter::PriorityOnly;
+            case StreamKind::Regular:
+                return channel->prioritySessions.load() > 0 ? PopFilter::RegularOnly : PopFilter::Any;
+            default: return PopFilter::Any;
+        }
+    };
+
+    // Short enough that a dead link stops the pops promptly
+    auto pollInterval = session->heartbeat.checkInterval();
+    auto stallInterval = session->flow.config().writeHigh;
+
+    while (true) {
+        // Wait for the previous write. While it is stuck behind a slow client,
+        // keep conflating the queue so fresh setpoints replace the backlog
+        auto state = session->waitReady(stallInterval);
+        if (state == Session::WriteState::Dead)
+            break;
+        if (state == Session::WriteState::Busy) {
+            session->flow.onWriteStalled(session->writeInFlight());
+            session->flow.hold(queue, filter());
+            continue;
+        }
+
+        // Pop the next message from the queue (gives up periodically to recheck the link).
+        // Regular setpoints are conflated to their newest value while the client is behind
+        Message msg;
+        if (!session->flow.next(queue, msg, pollInterval, filter()))
+            continue;
+
+        // Number messages across both streams so the client can merge them
+        if (session->stream != StreamKind::Single)
+            msg.setSequence(channel->nextSequence.fetch_add(1) + 1);
+
+        // Send the message's cached encoding to the client (encoded on first use)
+        if (!session->send(msg)) {
+            // The link died while this message was popped, keep it for the next client
+            session->flow.requeueAll(queue);
+            msg.setSequence(0);
+            queue.requeue(msg);
+            break;
+        }
+        if (verbose)
+            std::cout << "Sent message" << std::endl;
+    }
+
+    session->stop();
+    session->flow.requeueAll(queue);
+
+    // The write in flight when the link died is older than anything staged,
+    // so it goes back in front of them
+    Message unsent;
+    if (session->takeFailedWrite(unsent)) {
+        unsent.setSequence(0);
+        queue.requeue(unsent);
+    }
+    if (session->stream == StreamKind::Priority)
+        channel->prioritySessions.fetch_sub(1);
+    std::cerr << "Session disconnect: " << session->reason << "\n";
+
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    channel->sessions.erase(session->id);
+}
@@ -2,54 +2,179 @@
 #include <boost/asio.hpp>
 #include <thread>
 #include <boost/beast/websocket.hpp>
+#include <boost/beast/http.hpp>
 #include <iostream>
-#include "Message.h" 
-#include <sstream>   
+#include "Message.h"
+#include <sstream>
 #include "MessageQueue.h"
+#include "IMessageQueue.h"
+#include "Heartbeat.h"
+#include "FlowControl.h"
+#include "BufferPool.h"
+#include <atomic>
 #include <chrono>
-
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 class WebSocketServer {
 public:
+    // Snapshot of a connected session
+    struct SessionInfo {
+        uint64_t id;                    // Unique id of the session
+        std::string channel;            // Target path the client connected to
+        std::string stream;             // "priority" or "regular" in dual-stream mode, else empty
+        std::string remote;             // Remote endpoint address and port
+        std::chrono::microseconds rtt;  // Smoothed RTT (-1 until the first pong)
+        bool congested;                 // Regular traffic is being conflated
+        uint64_t conflated;             // Messages superseded before they were sent
+        size_t pendingBytes;            // Bytes unsent in the socket
+        BufferPool::Stats buffers;      // Allocation counters of the session's encoding pool
+    };
+
 /** Constructor for WebSocketServer
      *
      * @param
      *  port: unsigned short - The port number to listen for incoming connections
+     *  verbose: bool - Log every message sent to a client (default true)
+     *  heartbeat: HeartbeatConfig - Ping interval and dead-link timeout for sessions
+     *  flowControl: FlowControlConfig - When a slow session switches to conflated delivery
     */
-    WebSocketServer(unsigned short port);
+    WebSocketServer(unsigned short port, bool verbose = true,
+                    HeartbeatConfig heartbeat = HeartbeatConfig(),
+                    FlowControlConfig flowControl = FlowControlConfig());
+
+    /** Registers a channel backed by a queue owned by the server
+     *
+     * @param
+     *  target: const std::string& - Handshake path clients use to join (e.g. "/wheel")
+     *
+     * @return
+     *  IMessageQueue& - The channel's queue, for producers to push into
+     *
+     * Throws std::runtime_error if the target is already registered.
+     */
+    IMessageQueue& addChannel(const std::string& target);
+
+    /** Registers a channel backed by a caller-owned queue
+     *
+     * @param
+     *  target: const std::string& - Handshake path clients use to join (e.g. "/arm")
+     *  queue: IMessageQueue& - The channel's queue; must outlive the server
+     *
+     * @return
+     *  none
+     *
+     * Throws std::runtime_error if the target is already registered.
+     */
+    void addChannel(const std::string& target, IMessageQueue& queue);
+
+    /** Runs the WebSocket server, routing each client to the channel matching
+     * its handshake target. Clients asking for any other target are refused
+     * with 404.
+     *
+     * A client may open two connections to a channel, with "?stream=priority"
+     * and "?stream=regular" appended to the target (see DualStreamClient).
+     * High priority messages then go only over the priority connection, so
+     * they never wait behind a regular write in flight, and every message
+     * carries a channel-wide sequence number for merging the two streams
+     *
+     * Messages sampled by Tracer are sent with their " t=<id>" trailer only
+     * to clients that add "trace=1" to the query (WebSocketClient does when
+     * tracing is on). Every other client gets the same bytes as for an
+     * untraced message
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  none
+     */
+    void run();
 
-    /** Runs the WebSocket server
+    /** Runs the WebSocket server with a single channel at "/"
      *
      * @param
-     *  msg: const Message& - The message to send to the client(s)
+     *  queue: IMessageQueue& - The queue to send to the client(s)
      *
      * @return
      *  none
      */
-    void run(MessageQueue& queue);
+    void run(IMessageQueue& queue);
+
+    /** Returns the currently connected sessions
+     *
+     * @param
+     *  none
+     *
+     * @return
+     *  std::vector<SessionInfo> - One entry per live session
+     */
+    std::vector<SessionInfo> sessions();
 
 private:
+    struct Session;
+
+    // A named queue and the sessions draining it
+    struct Channel {
+        std::string target;
+        IMessageQueue* queue;
+        std::unique_ptr<MessageQueue> owned;   // Set if the server created the queue
+        std::map<uint64_t, std::shared_ptr<Session>> sessions;   // Live sessions by id
+        std::atomic<int> prioritySessions { 0 };   // Live "?stream=priority" sessions
+        std::atomic<uint64_t> nextSequence { 0 };  // Last sequence number sent in dual-stream mode
+    };
+
+    // Add a channel to the registry (throws if the target is taken)
+    Channel& registerChannel(const std::string& target, IMessageQueue& queue);
+
     /** Accepts client WebSocket connections
      *
      * @param
-     *  msg: const Message& - The message to send to the client(s)
+     *  none
      *
      * @return
      *  none
      */
-    void accept_connections(MessageQueue& queue);
+    void accept_connections();
+
+    /** Reads the HTTP upgrade request and finds the channel it targets, the
+     * stream the session carries if the target has a "stream" query, and
+     * whether the client wants trace ids ("trace=1")
+     *
+     * @param
+     *  session: Session& - The accepted connection
+     *  request: http::request<http::string_body>& - Receives the upgrade request
+     *
+     * @return
+     *  Channel* - The requested channel, or nullptr if the request cannot be
+     *             served (the client has been sent an error response)
+     */
+    Channel* route(Session& session,
+                   boost::beast::http::request<boost::beast::http::string_body>& request);
 
     /** Handles a single WebSocket session with a connected client
+     *
+     * Messages are only popped while the previous write has completed and the
+     * heartbeat considers the link alive, so commands stay queued for the next
+     * connection once a peer stops answering pings.
      *
      * @param
-     *  socket: boost::asio::ip::tcp::socket - The socket for the connected client
-     *  msg: const Message& - The message to send to the client
+     *  session: std::shared_ptr<Session> - The accepted connection
      *
      * @return
      *  none
      */
-    void handle_session(boost::asio::ip::tcp::socket socket, MessageQueue& queue);
+    void handle_session(std::shared_ptr<Session> session);
 
     boost::asio::io_context ioc;   // Boost ASIO IO context
     boost::asio::ip::tcp::acceptor acceptor;   // TCP acceptor for incoming connections
+    bool verbose;   // Log each sent message
+    HeartbeatConfig heartbeat;   // Heartbeat thresholds for new sessions
+    FlowControlConfig flowControl;   // Congestion thresholds for new sessions
+
+    std::mutex sessionsMutex;   // Guards channels, their sessions and nextSessionId
+    std::map<std::string, std::unique_ptr<Channel>> channels;   // Channels by target path
+    uint64_t nextSessionId = 0;
 };
@@ -0,0 +1,16 @@
+# Merge raw Clang profiles written by the PGO training run into rover.profdata
+#
+# Usage: cmake -DLLVM_PROFDATA=<tool> -DPROFILE_DIR=<dir> -P MergeProfiles.cmake
+
+file(GLOB raw_profiles "${PROFILE_DIR}/*.profraw")
+if(NOT raw_profiles)
+    message(FATAL_ERROR "No .profraw files found in ${PROFILE_DIR}")
+endif()
+
+execute_process(
+    COMMAND ${LLVM_PROFDATA} merge -output=${PROFILE_DIR}/rover.profdata ${raw_profiles}
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "llvm-profdata merge failed")
+endif()
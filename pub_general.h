@@ -2,6 +2,7 @@
 #define PUB_GENERAL_H
 
 // #include <SDL.h>
+#include <array>
 #include <functional>
 #include <iostream>
 
@@ -53,8 +54,9 @@ typedef void (*ControllerFunc)(void* args);
 // SDL_CONTROLLER_BUTTON_DPAD_RIGHT
 struct buttonFunctions {
     std::array<std::function<void()>, 15> buttonArray = { nullptr };
-    void (*LEFT_JOYSTICK)(int xValue, int yValue) = nullptr;
-    void (*RIGHT_JOYSTICK)(int xValue, int yValue) = nullptr;
+    // Stick callbacks take std::function so they can be bound to an object (see JoystickSampler)
+    std::function<void(int xValue, int yValue)> LEFT_JOYSTICK = nullptr;
+    std::function<void(int xValue, int yValue)> RIGHT_JOYSTICK = nullptr;
 };
 
 // Generic Message Format